@@ -0,0 +1,102 @@
+/*
+LED and buzzer alerts
+
+Timer0 interrupts every 8 ms in CTC mode and steps the pattern playing,
+which used to be toggled with a _delay_ms() in the report path.
+*/
+
+#include "Alert.h"
+
+#ifdef ALERT_WHEN_DONE
+
+// 16 MHz / 1024 / 125 = 125 Hz, so a 128 ms slot is 16 ticks
+#define ALERT_TICKS_PER_SEC  125
+#define ALERT_TICKS_PER_SLOT (ALERT_SLOT_MS * ALERT_TICKS_PER_SEC / 1000)
+
+const AlertPattern_t alert_patterns[ALERTS] PROGMEM = {
+	[ALERT_DONE]      = { .slots = 0x3333, .repeats = 0 },
+	[ALERT_ERROR]     = { .slots = 0x0015, .repeats = 3 },
+	[ALERT_SYNC_LOST] = { .slots = 0x00FF, .repeats = 0 },
+};
+
+// Only touched with Timer0 stopped or from its interrupt
+uint16_t alert_slots;
+uint8_t alert_repeats_left; // 0 when playing until stopped
+uint8_t alert_slot;
+uint8_t alert_ticks;
+
+static void SetAlertPins(const uint8_t value)
+{
+	PORTD = value;
+	PORTB = value;
+}
+
+static void StopAlertTimer(void)
+{
+	TCCR0B = 0;
+	TIMSK0 = 0;
+	SetAlertPins(0x00);
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	if (++alert_ticks < ALERT_TICKS_PER_SLOT)
+		return;
+	alert_ticks = 0;
+
+	if (++alert_slot == 16)
+	{
+		alert_slot = 0;
+		if (alert_repeats_left > 0 && --alert_repeats_left == 0)
+		{
+			StopAlertTimer();
+			return;
+		}
+	}
+	SetAlertPins(alert_slots & (1 << alert_slot) ? 0xFF : 0x00);
+}
+
+void InitAlert(void)
+{
+	// Both PORTD and PORTB will be used for the optional LED flashing and buzzer.
+	#warning LED and Buzzer functionality enabled. All pins on both PORTB and \
+PORTD will toggle on alerts.
+	DDRD  = 0xFF; //Teensy uses PORTD
+	PORTD =  0x0;
+		 //We'll just flash all pins on both ports since the UNO R3
+	DDRB  = 0xFF; //uses PORTB. Micro can use either or, but both give us 2 LEDs
+	PORTB =  0x0; //The ATmega328P on the UNO will be resetting, so unplug it?
+}
+
+void StartAlert(const Alert_t alert)
+{
+	AlertPattern_t pattern;
+	memcpy_P(&pattern, &alert_patterns[alert], sizeof(AlertPattern_t));
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		StopAlertTimer();
+		alert_slots = pattern.slots;
+		alert_repeats_left = pattern.repeats;
+		alert_slot = 0;
+		alert_ticks = 0;
+		SetAlertPins(alert_slots & 1 ? 0xFF : 0x00);
+
+		TCCR0A = (1 << WGM01); // CTC
+		OCR0A = F_CPU / 1024 / ALERT_TICKS_PER_SEC - 1;
+		TCNT0 = 0;
+		TIFR0 = (1 << OCF0A);
+		TIMSK0 = (1 << OCIE0A);
+		TCCR0B = (1 << CS02) | (1 << CS00); // clk / 1024
+	}
+}
+
+void StopAlert(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		StopAlertTimer();
+	}
+}
+
+#endif
@@ -0,0 +1,41 @@
+/** \file
+ *
+ *  Header file for Alert.c.
+ */
+
+#ifndef _ALERT_H_
+#define _ALERT_H_
+
+#include "Joystick.h"
+
+// LED and buzzer patterns on every pin of PORTB and PORTD, built only with "make ALERT=1".
+// Timer0 plays them in the background, so USB and serial keep running at full rate.
+typedef enum {
+	ALERT_DONE,      // a one-shot table has finished (slow blinks until stopped)
+	ALERT_ERROR,     // input has been lost to an overflow (three short blinks, three times)
+	ALERT_SYNC_LOST, // the host has gone away (about 1 s on, 1 s off until it comes back)
+	ALERTS
+} Alert_t;
+
+// A pattern is 16 slots of ALERT_SLOT_MS; bit n lights slot n.
+#define ALERT_SLOT_MS 128
+
+typedef struct {
+	uint16_t slots;
+	uint8_t  repeats; // cycles to play, 0 for until stopped
+} AlertPattern_t;
+
+#ifdef ALERT_WHEN_DONE
+// Set the pins up as outputs. Nothing else may use Timer0 after this.
+void InitAlert(void);
+// Play a pattern from its start, replacing the one playing; safe to call from interrupts.
+void StartAlert(const Alert_t alert);
+// Turn the pins off.
+void StopAlert(void);
+#else
+#define InitAlert()       do { } while (0)
+#define StartAlert(alert) do { } while (0)
+#define StopAlert()       do { } while (0)
+#endif
+
+#endif
@@ -19,21 +19,37 @@ const Command unsync[] PROGMEM = {
 	{ NOP,      20 },
 	{ DOWN,		5 },
     { NOP, 		2 },
+	{ OP_REPEAT, 3 },
     { RIGHT, 	2 },
     { NOP, 		5 },
-    { RIGHT, 	2 },
-    { NOP,  	5 },
-    { RIGHT,  	2 },
-	{ NOP, 		5 },
+	{ OP_END,	0 },
 	{ A,        5 },
     { NOP, 		60 },
+	{ OP_REPEAT, 2 },
 	{ A,        2 },
 	{ NOP,      30 },
-	{ A,        2 },
-	{ NOP,      30 },
+	{ OP_END,	0 },
 };
 const int unsync_size = (int)(sizeof(unsync) / sizeof(Command));
 
+// HOME menu to System Settings (call it after moving down to the bottom row)
+const Command to_settings[] PROGMEM = {
+	{ OP_REPEAT, 4 },
+    { RIGHT, 	2 },
+    { NOP, 		5 },
+	{ OP_END,	0 },
+	{ A,		5 }, // 設定選択
+};
+
+// System item of System Settings to Date and Time
+const Command to_date_time[] PROGMEM = {
+	{ OP_REPEAT, 4 },
+    { DOWN,		5 },
+    { NOP,   	10 },
+	{ OP_END,	0 },
+	{ A,		5 }, // 日付と時刻選択
+};
+
 // Mashing button A
 const Command mash_a_commands[] PROGMEM = {
 	{ NOP,      20 },
@@ -57,26 +73,10 @@ const int mash_home_size = (int)(sizeof(mash_home_commands) / sizeof(Command));
 
 // Auto League
 const Command auto_league_commands[] PROGMEM = {
+	{ OP_REPEAT, 10 },
 	{ NOP,      20 },
 	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
-	{ NOP,      20 },
-	{ A,        5 },
+	{ OP_END,	0 },
 
 	{ NOP,      20 },
 	{ B,        5 },
@@ -97,37 +97,21 @@ const Command inf_watt_commands[] PROGMEM = {
     { NOP, 		20 },
     { DOWN,		5 },
     { NOP, 		2 },
-    { RIGHT, 	2 },
-    { NOP, 		5 },
-    { RIGHT, 	2 },
-    { NOP,  	5 },
-    { RIGHT,  	2 },
-    { NOP, 		5 },
-    { RIGHT,  	2 },
-    { NOP,   	5 },
-    { A,		5 }, // 設定選択
+	{ OP_CALL,	SUB_TO_SETTINGS },
     { NOP,   	20 },
     { DOWN,   	60 },
     { NOP,   	20 },
 
     { A,		5 }, // 設定>本体 選択
     { NOP,   	20 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { A,		5 }, // 日付と時刻選択
+	{ OP_CALL,	SUB_TO_DATE_TIME },
     { NOP,   	10 },
     { A,		5 },
     { NOP,   	10 },
+	{ OP_REPEAT, 2 },
     { DOWN,		5 },
     { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
+	{ OP_END,	0 },
     { A,		5 },
     { NOP,   	20 },
     { UP,	  	5 },
@@ -159,15 +143,7 @@ const Command inf_watt_commands[] PROGMEM = {
     { NOP,   	20 },
     { DOWN,		2 },
     { NOP,   	5 },
-    { RIGHT,	2 },
-    { NOP,   	5 },
-    { RIGHT, 	2 },
-    { NOP,   	5 },
-    { RIGHT,	2 },
-    { NOP,   	5 },
-    { RIGHT,	2 },
-    { NOP,   	5 },
-    { A,		5 }, // 設定選択
+	{ OP_CALL,	SUB_TO_SETTINGS },
     { NOP,   	20 },
     { DOWN,		60 },
 
@@ -175,15 +151,7 @@ const Command inf_watt_commands[] PROGMEM = {
     { NOP,   	20 },
     { A,		5 }, // 設定>本体 選択
     { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { DOWN,		5 },
-    { NOP,   	10 },
-    { A,		5 }, // 日付と時刻選択
+	{ OP_CALL,	SUB_TO_DATE_TIME },
     { NOP,   	20 },
     { A,		5 },
     { NOP,   	20 },
@@ -192,3 +160,43 @@ const Command inf_watt_commands[] PROGMEM = {
     { HOME,		5 }, // ゲームへ
 };
 const int inf_watt_size = (int)(sizeof(inf_watt_commands) / sizeof(Command));
+
+// Tables that any table or macro can OP_CALL (in the order of Subroutine_id_t)
+const Subroutine_t subroutines[] PROGMEM = {
+	SUBROUTINE(sync),
+	SUBROUTINE(unsync),
+	SUBROUTINE(to_settings),
+	SUBROUTINE(to_date_time),
+};
+const int subroutines_size = (int)(sizeof(subroutines) / sizeof(Subroutine_t));
+
+// Tables the PC can start by name (see TableEntry_t)
+// The first ones are played on lines that name nothing
+const TableEntry_t command_registry[] PROGMEM = {
+	{ 0x70E5, mash_x_commands,      (int)(sizeof(mash_x_commands) / sizeof(Command)),      TABLE_LOOP,    0, 0 }, // "mash_x" (empty line)
+	{ 0x2356, mash_home_commands,   (int)(sizeof(mash_home_commands) / sizeof(Command)),   TABLE_LOOP,    0, 0 }, // "mash_home" (unknown name)
+	{ 0x70CE, mash_a_commands,      (int)(sizeof(mash_a_commands) / sizeof(Command)),      TABLE_LOOP,    0, 0 }, // "mash_a"
+	{ 0x9C70, auto_league_commands, (int)(sizeof(auto_league_commands) / sizeof(Command)), TABLE_FIXED_STICK, 172, 7 }, // "auto_league"
+	{ 0xEA61, inf_watt_commands,    (int)(sizeof(inf_watt_commands) / sizeof(Command)),    TABLE_LOOP,    0, 0 }, // "inf_watt"
+	{ 0x3062, sync,                 (int)(sizeof(sync) / sizeof(Command)),                 TABLE_ONESHOT, 0, 0 }, // "sync"
+	{ 0x3EA5, unsync,               (int)(sizeof(unsync) / sizeof(Command)),               TABLE_ONESHOT, 0, 0 }, // "unsync"
+};
+const int command_registry_size = (int)(sizeof(command_registry) / sizeof(TableEntry_t));
+
+uint16_t HashName(const char* name)
+{
+	uint16_t hash = 5381;
+	while (*name)
+		hash = hash * 33 + (uint8_t)*name++;
+	return hash;
+}
+
+int FindTable(const uint16_t hash)
+{
+	for (int i = 0; i < command_registry_size; i++)
+	{
+		if (pgm_read_word(&command_registry[i].hash) == hash)
+			return i;
+	}
+	return -1;
+}
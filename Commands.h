@@ -12,7 +12,87 @@ typedef struct {
 	uint16_t duration;
 } Command; 
 
+// Durations count units of a few reports by default (about 15 ms at the rate asked for, see
+// PollRate.h), so real time depends on how often the host polls. Wrap a duration in MS() to time it in milliseconds on the USB SOF clock
+// instead (up to 32767 ms). Building with COMMAND_UNIT_MS=<ms> times plain durations on the
+// SOF clock too, as that many milliseconds per unit.
+#define DURATION_MS 0x8000
+#define MS(ms) (DURATION_MS | (ms))
+
+// Tables may use the OP_* values of Buttons_t as a small bytecode:
+//   { OP_REPEAT, n }, ..., { OP_END, 0 }  plays the commands in between n times, where 0 skips them
+//                                         (can be nested; loops past MAX_REPEAT_DEPTH play once)
+//   { OP_CALL, SUB_xxx }                  plays a table in subroutines[] and comes back
+//   { OP_RET, 0 }                         returns from a subroutine early
+//   { OP_WAIT, d }                        holds the last report for d, where NOP would release it
+// Tables without opcodes run as before.
+//
+// A single enum value presses one button or tilts the left stick to one edge. Anything else,
+// like A+B, ZL, CAPTURE, the HAT or the right stick, goes in a longer entry:
+//   PRESS(SWITCH_A | SWITCH_B, HAT_TOP, 5)                     2 entries, sticks centered
+//   REPORT(SWITCH_ZL, HAT_CENTER, 172, 7, 128, 128, 5)         4 entries, the whole report
+//   STICK_L(lx, ly) / STICK_R(rx, ry) before any other entry   1 entry each, moves that stick
+#define PRESS(buttons, hat, duration) \
+	{ OP_PRESS, (buttons) }, { (Buttons_t)(hat), (duration) }
+#define STICK_L(x, y) { OP_STICK_L, (uint16_t)((x) | ((y) << 8)) }
+#define STICK_R(x, y) { OP_STICK_R, (uint16_t)((x) | ((y) << 8)) }
+#define REPORT(buttons, hat, lx, ly, rx, ry, duration) \
+	STICK_L(lx, ly), STICK_R(rx, ry), PRESS(buttons, hat, duration)
+#define MAX_CALL_DEPTH   4
+#define MAX_REPEAT_DEPTH 4
+#define MAX_OPS_PER_STEP 16 // opcodes run in a row before a report has to go out
+
+typedef struct {
+	const Command* commands;
+	int size;
+} Subroutine_t;
+#define SUBROUTINE(table) { table, (int)(sizeof(table) / sizeof(Command)) }
+
+// Indices of subroutines[]
+typedef enum {
+	SUB_SYNC,
+	SUB_UNSYNC,
+	SUB_TO_SETTINGS,  // HOME menu to System Settings
+	SUB_TO_DATE_TIME, // System item of System Settings to Date and Time
+} Subroutine_id_t;
+
+// Called from PROGMEM tables and EEPROM macros alike
+extern const Subroutine_t subroutines[];
+extern const int subroutines_size;
+
+// Tables the PC can start by name
+// Names are looked up by HashName() (16-bit djb2), so the hash of a new entry
+// should be checked against the others once.
+#define TABLE_LOOP        0x00 // start over at the end
+#define TABLE_ONESHOT     0x01 // stop at the end
+#define TABLE_FIXED_STICK 0x02 // hold the left stick at (lx, ly) while playing
+
+typedef struct {
+	uint16_t hash;
+	const Command* commands;
+	int size;
+	uint8_t flags;
+	uint8_t lx, ly;
+} TableEntry_t;
+
+extern const TableEntry_t command_registry[];
+extern const int command_registry_size;
+
+// Indices of command_registry[] played on lines that name nothing (for debug)
+#define REGISTRY_EMPTY_LINE 0
+#define REGISTRY_UNKNOWN    1
+
+uint16_t HashName(const char* name);
+// return: the index in command_registry[] or -1
+int FindTable(const uint16_t hash);
+
+// Forget the playing table (and its loops and calls) to start over.
+void ResetSteps(void);
+
 bool GetNextReportFromCommands(const Command* const commands, int step_size, USB_JoystickReport_Input_t* const ReportData);
+// The same as GetNextReportFromCommands() for commands stored in EEPROM
+bool GetNextReportFromMacro(const Command* const commands, int step_size, USB_JoystickReport_Input_t* const ReportData);
+bool GetNextReportFromSource(const Command* const commands, bool is_eeprom, int step_size, USB_JoystickReport_Input_t* const ReportData);
 
 // The commands that run independently from a PC
 // Store arrays in Flash memory to save a SRAM data capacity
@@ -1,4 +1,5 @@
 #include "Descriptors.h"
+#include "PollRate.h"
 
 // HID Descriptors.
 const USB_Descriptor_HIDReport_Datatype_t PROGMEM JoystickReport[] = {
@@ -79,69 +80,62 @@ const USB_Descriptor_Device_t PROGMEM DeviceDescriptor = {
 	.NumberOfConfigurations = FIXED_NUM_CONFIGURATIONS
 };
 
-// Configuration Descriptor Structure
-const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor = {
-	.Config =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
-
-			.TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
-			.TotalInterfaces        = 1,
-
-			.ConfigurationNumber    = 1,
-			.ConfigurationStrIndex  = NO_DESCRIPTOR,
-
-			.ConfigAttributes       = 0x80,
-
-			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(500)
-		},
-
-	.HID_Interface =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
-
-			.InterfaceNumber        = INTERFACE_ID_Joystick,
-			.AlternateSetting       = 0x00,
-
-			.TotalEndpoints         = 2,
-
-			.Class                  = HID_CSCP_HIDClass,
-			.SubClass               = HID_CSCP_NonBootSubclass,
-			.Protocol               = HID_CSCP_NonBootProtocol,
-
-			.InterfaceStrIndex      = NO_DESCRIPTOR
-		},
-
-	.HID_JoystickHID =
-		{
-			.Header                 = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID},
-
-			.HIDSpec                = VERSION_BCD(1,1,1),
-			.CountryCode            = 0x00,
-			.TotalReportDescriptors = 1,
-			.HIDReportType          = HID_DTYPE_Report,
-			.HIDReportLength        = sizeof(JoystickReport)
-		},
-
-	.HID_ReportINEndpoint =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
-
-			.EndpointAddress        = JOYSTICK_IN_EPADDR,
-			.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
-			.EndpointSize           = JOYSTICK_EPSIZE,
-			.PollingIntervalMS      = 0x05
-		},
-
-	.HID_ReportOUTEndpoint =
-		{
-			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+// Configuration Descriptor Structure, one for every report rate profile (see PollRate.h)
+// They differ only in the polling interval of the endpoints.
+#define CONFIGURATION_DESCRIPTOR(interval_ms) { \
+	.Config = \
+		{ \
+			.Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration}, \
+			.TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t), \
+			.TotalInterfaces        = 1, \
+			.ConfigurationNumber    = 1, \
+			.ConfigurationStrIndex  = NO_DESCRIPTOR, \
+			.ConfigAttributes       = 0x80, \
+			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(500) \
+		}, \
+	.HID_Interface = \
+		{ \
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface}, \
+			.InterfaceNumber        = INTERFACE_ID_Joystick, \
+			.AlternateSetting       = 0x00, \
+			.TotalEndpoints         = 2, \
+			.Class                  = HID_CSCP_HIDClass, \
+			.SubClass               = HID_CSCP_NonBootSubclass, \
+			.Protocol               = HID_CSCP_NonBootProtocol, \
+			.InterfaceStrIndex      = NO_DESCRIPTOR \
+		}, \
+	.HID_JoystickHID = \
+		{ \
+			.Header                 = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID}, \
+			.HIDSpec                = VERSION_BCD(1,1,1), \
+			.CountryCode            = 0x00, \
+			.TotalReportDescriptors = 1, \
+			.HIDReportType          = HID_DTYPE_Report, \
+			.HIDReportLength        = sizeof(JoystickReport) \
+		}, \
+	.HID_ReportINEndpoint = \
+		{ \
+			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint}, \
+			.EndpointAddress        = JOYSTICK_IN_EPADDR, \
+			.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA), \
+			.EndpointSize           = JOYSTICK_EPSIZE, \
+			.PollingIntervalMS      = (interval_ms) \
+		}, \
+	.HID_ReportOUTEndpoint = \
+		{ \
+			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint}, \
+			.EndpointAddress        = JOYSTICK_OUT_EPADDR, \
+			.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA), \
+			.EndpointSize           = JOYSTICK_EPSIZE, \
+			.PollingIntervalMS      = (interval_ms) \
+		}, \
+}
 
-			.EndpointAddress        = JOYSTICK_OUT_EPADDR,
-			.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
-			.EndpointSize           = JOYSTICK_EPSIZE,
-			.PollingIntervalMS      = 0x05
-		},
+const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptors[POLL_RATES] = {
+	[POLL_RATE_1MS] = CONFIGURATION_DESCRIPTOR(1),
+	[POLL_RATE_4MS] = CONFIGURATION_DESCRIPTOR(4),
+	[POLL_RATE_5MS] = CONFIGURATION_DESCRIPTOR(5),
+	[POLL_RATE_8MS] = CONFIGURATION_DESCRIPTOR(8),
 };
 
 // Language Descriptor Structure
@@ -170,7 +164,7 @@ uint16_t CALLBACK_USB_GetDescriptor(
 			Size    = sizeof(USB_Descriptor_Device_t);
 			break;
 		case DTYPE_Configuration:
-			Address = &ConfigurationDescriptor;
+			Address = &ConfigurationDescriptors[poll_rate];
 			Size    = sizeof(USB_Descriptor_Configuration_t);
 			break;
 		case DTYPE_String:
@@ -192,7 +186,7 @@ uint16_t CALLBACK_USB_GetDescriptor(
 
 			break;
 		case DTYPE_HID:
-			Address = &ConfigurationDescriptor.HID_JoystickHID;
+			Address = &ConfigurationDescriptors[poll_rate].HID_JoystickHID;
 			Size    = sizeof(USB_HID_Descriptor_HID_t);
 			break;
 		case DTYPE_Report:
@@ -0,0 +1,130 @@
+/*
+Input queue for jitter-free playback
+
+PC fills the queue with (report, polls) entries ahead of time and
+GetNextReport() pops them on exact poll boundaries, so hold lengths
+don't depend on the timing of the serial line or the PC.
+Both ends run in the main loop, so no locking is needed.
+*/
+
+#include "InputQueue.h"
+
+QueueEntry_t queue[INPUT_QUEUE_SIZE];
+uint8_t queue_head = 0;
+uint8_t queue_tail = 0;
+uint8_t queue_count = 0;
+
+uint16_t queue_poll_count = 0;
+
+// Loop playing (see QUEUE_REPEAT_MARK)
+uint8_t repeat_span = 0;  // 0 when not in a loop
+uint8_t repeat_pos = 0;   // the entry playing, counted from queue_tail
+uint16_t repeat_left;     // passes left after this one
+USB_JoystickReport_Input_t queue_last_report = {
+	.Button = 0,
+	.HAT = HAT_CENTER,
+	.LX = STICK_CENTER,
+	.LY = STICK_CENTER,
+	.RX = STICK_CENTER,
+	.RY = STICK_CENTER,
+};
+
+bool PushInputQueue(const QueueEntry_t* const entry)
+{
+	if (queue_count >= INPUT_QUEUE_SIZE)
+		return false;
+
+	memcpy(&queue[queue_head], entry, sizeof(QueueEntry_t));
+	queue_head = (queue_head + 1) & (INPUT_QUEUE_SIZE - 1);
+	queue_count++;
+	return true;
+}
+
+bool PushInputQueueRepeat(const uint16_t count, const uint8_t span)
+{
+	if (span == 0 || span >= INPUT_QUEUE_SIZE)
+		return false;
+
+	QueueEntry_t marker;
+	memset(&marker, 0, sizeof(QueueEntry_t));
+	marker.report.Button = count;
+	marker.report.HAT = span;
+	marker.polls = QUEUE_REPEAT_MARK;
+	return PushInputQueue(&marker);
+}
+
+void ClearInputQueue(void)
+{
+	queue_head = 0;
+	queue_tail = 0;
+	queue_count = 0;
+	queue_poll_count = 0;
+	repeat_span = 0;
+	repeat_pos = 0;
+
+	memset(&queue_last_report, 0, sizeof(USB_JoystickReport_Input_t));
+	queue_last_report.LX = STICK_CENTER;
+	queue_last_report.LY = STICK_CENTER;
+	queue_last_report.RX = STICK_CENTER;
+	queue_last_report.RY = STICK_CENTER;
+	queue_last_report.HAT = HAT_CENTER;
+}
+
+uint8_t InputQueueFreeSlots(void)
+{
+	return INPUT_QUEUE_SIZE - queue_count;
+}
+
+void PopInputQueue(const uint8_t n)
+{
+	queue_tail = (queue_tail + n) & (INPUT_QUEUE_SIZE - 1);
+	queue_count -= n;
+}
+
+bool GetNextReportFromQueue(USB_JoystickReport_Input_t* const ReportData)
+{
+	// a loop marker takes no poll of its own
+	if (repeat_span == 0 && queue_count > 0 && queue[queue_tail].polls == QUEUE_REPEAT_MARK)
+	{
+		const QueueEntry_t* const marker = &queue[queue_tail];
+		repeat_span = marker->report.HAT;
+		repeat_left = marker->report.Button > 0 ? marker->report.Button - 1 : 0;
+		repeat_pos = 0;
+		PopInputQueue(1);
+	}
+
+	// wait for the rest of the loop body if it hasn't arrived yet
+	if (queue_count <= repeat_pos)
+	{
+		memcpy(ReportData, &queue_last_report, sizeof(USB_JoystickReport_Input_t));
+		return false;
+	}
+
+	QueueEntry_t* const entry = &queue[(queue_tail + repeat_pos) & (INPUT_QUEUE_SIZE - 1)];
+	memcpy(ReportData, &entry->report, sizeof(USB_JoystickReport_Input_t));
+
+	// an entry is sent at least once
+	if (++queue_poll_count >= entry->polls)
+	{
+		memcpy(&queue_last_report, &entry->report, sizeof(USB_JoystickReport_Input_t));
+		queue_poll_count = 0;
+
+		if (repeat_span == 0)
+			PopInputQueue(1);
+		else if (++repeat_pos < repeat_span)
+			; // the next entry of the body
+		else if (repeat_left > 0)
+		{
+			repeat_left--;
+			repeat_pos = 0;
+		}
+		else
+		{
+			PopInputQueue(repeat_span);
+			repeat_span = 0;
+			repeat_pos = 0;
+		}
+	}
+
+	return true;
+}
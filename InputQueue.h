@@ -0,0 +1,37 @@
+/** \file
+ *
+ *  Header file for InputQueue.c.
+ */
+
+#ifndef _INPUT_QUEUE_H_
+#define _INPUT_QUEUE_H_
+
+#include "Joystick.h"
+
+// Reports sent from PC ahead of time, each held for a number of polls
+// Every entry takes 10 bytes of SRAM
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE 8 // must be a power of 2
+#endif
+
+typedef struct {
+	USB_JoystickReport_Input_t report;
+	uint16_t polls; // how many times GetNextReport() sends this report
+} QueueEntry_t;
+
+// An entry with no polls marks a loop instead of a report:
+// the next report.HAT entries are played report.Button times.
+// The loop body stays in the queue until the last pass, so it has to fit in the queue.
+#define QUEUE_REPEAT_MARK 0
+
+// return: the entry has been queued? (false if the queue is full)
+bool PushInputQueue(const QueueEntry_t* const entry);
+// return: the loop marker has been queued? (false if the queue is full or the body can't fit)
+bool PushInputQueueRepeat(const uint16_t count, const uint8_t span);
+// Drop all queued entries and go back to the neutral report.
+void ClearInputQueue(void);
+uint8_t InputQueueFreeSlots(void);
+// return: an entry was playing? (the last report is repeated once the queue runs dry)
+bool GetNextReportFromQueue(USB_JoystickReport_Input_t* const ReportData);
+
+#endif
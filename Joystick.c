@@ -20,27 +20,68 @@ these buttons for our use.
 
 #include <LUFA/Drivers/Peripheral/Serial.h>
 #include "Commands.h"
+#include "Protocol.h"
+#include "InputQueue.h"
+#include "Macros.h"
+#include "Latency.h"
+#include "Profile.h"
+#include "Alert.h"
+#include "PollRate.h"
+
+// The PC report is double buffered. The parsers edit the back buffer and publish it
+// by bumping pc_report_seq, a single byte store, so GetNextReport() never copies
+// a half-written report and the hot path needs no interrupt masking.
+USB_JoystickReport_Input_t pc_reports[2];
+volatile uint8_t pc_report_seq = 0; // the front buffer is pc_reports[pc_report_seq & 1]
+
+// return: the back buffer, holding a copy of the front one to edit
+USB_JoystickReport_Input_t* BeginPCReport(void)
+{
+	const uint8_t seq = pc_report_seq;
+	USB_JoystickReport_Input_t* const back = &pc_reports[(seq + 1) & 1];
+	memcpy(back, &pc_reports[seq & 1], sizeof(USB_JoystickReport_Input_t));
+	return back;
+}
+
+// Make the back buffer the front one (an unpublished back buffer is simply dropped)
+void PublishPCReport(void)
+{
+	pc_report_seq++;
+}
 
-USB_JoystickReport_Input_t pc_report;
+void ReadPCReport(USB_JoystickReport_Input_t* const report)
+{
+	uint8_t seq;
+	do
+	{
+		seq = pc_report_seq;
+		memcpy(report, &pc_reports[seq & 1], sizeof(USB_JoystickReport_Input_t));
+	}
+	while (seq != pc_report_seq); // published again while copying, so the copy may be torn
+}
 
 void ResetDirections()
 {
-	pc_report.LX = 128;
-	pc_report.LY = 128;
-	pc_report.RX = 128;
-	pc_report.RY = 128;
-	pc_report.HAT = HAT_CENTER;
+	USB_JoystickReport_Input_t* const report = BeginPCReport();
+	report->LX = 128;
+	report->LY = 128;
+	report->RX = 128;
+	report->RY = 128;
+	report->HAT = HAT_CENTER;
+	PublishPCReport();
 }
 
 // Main entry point.
 int main(void) {
-	Serial_Init(9600, false);
+	InitSerial(SERIAL_BAUD);
 	Serial_CreateStream(NULL);
 
 	sei();
-	UCSR1B |= (1 << RXCIE1);
 
 	ResetDirections();
+	InitMacros();
+	InitCycleCounter();
+	InitPollRate();
 
 	// We'll start by performing hardware and peripheral setup.
 	SetupHardware();
@@ -49,10 +90,18 @@ int main(void) {
 	// Once that's done, we'll enter an infinite loop.
 	for (;;)
 	{
+		PROFILE_BEGIN(loop_start);
+		// We parse serial input here instead of in the RX interrupt.
+		SerialTask();
+		// EEPROM writes of macros go a byte at a time, so that nothing waits on them.
+		MacroTask();
+		// Frames to the PC are sent a byte at a time, so that nothing waits on the serial line.
+		OutputTask();
 		// We need to run our task to process and deliver data for our IN and OUT endpoints.
 		HID_Task();
 		// We also need to run the main USB management task.
 		USB_USBTask();
+		PROFILE_END(PROFILE_MAIN_LOOP, loop_start);
 	}
 }
 
@@ -66,16 +115,7 @@ void SetupHardware(void) {
 	clock_prescale_set(clock_div_1);
 	// We can then initialize our hardware and peripherals, including the USB stack.
 
-	#ifdef ALERT_WHEN_DONE
-	// Both PORTD and PORTB will be used for the optional LED flashing and buzzer.
-	#warning LED and Buzzer functionality enabled. All pins on both PORTB and \
-PORTD will toggle when printing is done.
-	DDRD  = 0xFF; //Teensy uses PORTD
-	PORTD =  0x0;
-		 //We'll just flash all pins on both ports since the UNO R3
-	DDRB  = 0xFF; //uses PORTB. Micro can use either or, but both give us 2 LEDs
-	PORTB =  0x0; //The ATmega328P on the UNO will be resetting, so unplug it?
-	#endif
+	InitAlert();
 	// The USB stack should be initialized last.
 	USB_Init();
 }
@@ -88,6 +128,7 @@ void EVENT_USB_Device_Connect(void) {
 // Fired to indicate that the device is no longer connected to a host.
 void EVENT_USB_Device_Disconnect(void) {
 	// We can indicate that our device is not ready (via status LEDs, sound, etc.).
+	StartAlert(ALERT_SYNC_LOST);
 }
 
 // Fired when the host set the current configuration of the USB device after enumeration.
@@ -99,6 +140,104 @@ void EVENT_USB_Device_ConfigurationChanged(void) {
 	ConfigSuccess &= Endpoint_ConfigureEndpoint(JOYSTICK_IN_EPADDR, EP_TYPE_INTERRUPT, JOYSTICK_EPSIZE, 1);
 
 	// We can read ConfigSuccess to indicate a success or failure at this point.
+	// The host polls at the new rate from now on.
+	ResetPollCount();
+	// The host is back, so whatever was signalled before is over.
+	StopAlert();
+
+	// We use SOF events as a 1 ms clock.
+	USB_Device_EnableSOFEvents();
+}
+
+// Fired every 1 ms by the USB start of frame packet (in interrupt context).
+volatile uint16_t ms_ticks = 0;
+void EVENT_USB_Device_StartOfFrame(void) {
+	ms_ticks++;
+}
+
+uint16_t GetMillis(void) {
+	uint16_t ms;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ms = ms_ticks;
+	}
+	return ms;
+}
+
+// OUT reports forwarded to the PC ("output on")
+// The host sends them on the OUT endpoint or with SetReport; only changes are forwarded,
+// so a host repeating the same report costs nothing on the serial line.
+// The USB paths only keep the report; OutputTask() sends it from the main loop,
+// and a report changed again before that replaces it.
+bool is_output_mode = false;
+bool is_output_forwarded = false; // last_output holds what the PC has been or will be sent
+bool is_output_pending = false;   // last_output hasn't been put in a frame yet
+USB_JoystickReport_Output_t last_output;
+
+// The frame being sent, a byte whenever the USART can take one
+uint8_t tx_frame[FRAME_MAX_PAYLOAD + 4];
+uint8_t tx_frame_len = 0;
+uint8_t tx_frame_pos = 0;
+
+static inline bool IsFrameSending(void)
+{
+	return tx_frame_pos < tx_frame_len;
+}
+
+// Put a frame in tx_frame; it must be free.
+void QueueFrame(const uint8_t type, const uint8_t* const payload, const uint8_t len)
+{
+	uint8_t sum = len + type;
+	tx_frame[0] = FRAME_SYNC;
+	tx_frame[1] = len;
+	tx_frame[2] = type;
+	for (uint8_t i = 0; i < len; i++)
+	{
+		tx_frame[3 + i] = payload[i];
+		sum += payload[i];
+	}
+	tx_frame[3 + len] = sum;
+	tx_frame_len = len + 4;
+	tx_frame_pos = 0;
+}
+
+// Send what's left of the frame; called before any other reply, which must not land inside it.
+void FinishFrame(void)
+{
+	while (IsFrameSending())
+		Serial_SendByte(tx_frame[tx_frame_pos++]);
+}
+
+void ForwardOutputReport(const USB_JoystickReport_Output_t* const report)
+{
+	if (!is_output_mode)
+		return;
+	if (is_output_forwarded && memcmp(report, &last_output, sizeof(last_output)) == 0)
+		return;
+
+	memcpy(&last_output, report, sizeof(last_output));
+	is_output_forwarded = true;
+	is_output_pending = true;
+}
+
+void OutputTask(void)
+{
+	if (!IsFrameSending() && is_output_pending)
+	{
+		is_output_pending = false;
+		// dropped if "output off" came in between
+		if (is_output_mode)
+		{
+			const uint8_t payload[] = {
+				last_output.Button & 0xFF, last_output.Button >> 8, last_output.HAT,
+				last_output.LX, last_output.LY, last_output.RX, last_output.RY,
+			};
+			QueueFrame(FRAME_OUTPUT_REPORT, payload, sizeof(payload));
+		}
+	}
+
+	while (IsFrameSending() && Serial_IsSendReady())
+		Serial_SendByte(tx_frame[tx_frame_pos++]);
 }
 
 // Process control requests sent to the device from the USB host.
@@ -135,13 +274,62 @@ void EVENT_USB_Device_ControlRequest(void) {
 			Endpoint_Read_Control_Stream_LE(&JoystickOutputData, sizeof(JoystickOutputData));
 			// We then send an IN packet on this endpoint.
 			Endpoint_ClearIN();
+			// The PC may want to know what the host has set.
+			ForwardOutputReport(&JoystickOutputData);
 		}
 
 		break;
 	}
 }
 
+// Input latency (shown by "stats")
+// Input that replaces the PC report is timed from the RX interrupt receiving its last byte
+// to the end of parsing (time spent in the ring buffer included), and from there to the
+// host taking the IN report carrying it.
+bool is_report_updated = false;    // set by the parsers when the PC report has changed
+bool is_latency_pending = false;   // the PC report has changed since the last IN report
+bool is_latency_in_flight = false; // the IN bank holds the changed report
+bool is_report_in_bank = false;    // the host hasn't taken the last IN report yet
+uint32_t parsed_cycles;
+uint32_t in_flight_cycles;
+Latency_t parse_latency;
+Latency_t poll_latency;
+
+// Credits for the input queue (see PROTO_CREDIT)
+bool is_credit_mode = false;
+uint8_t advertised_credits = 0; // free slots the PC has last been told about
+
+void SendCredits(void)
+{
+	FinishFrame();
+	advertised_credits = InputQueueFreeSlots();
+	Serial_SendByte(PROTO_CREDIT | (advertised_credits & PROTO_CREDIT_MASK));
+}
+
+// Endpoint transfers that never wait on the host.
+// A report is far smaller than the endpoint, so once the bank is free it's written in one go;
+// the stream functions would spin until the host polls if the bank filled up halfway.
+static inline void WriteEndpointReport(const void* const report, const uint8_t size)
+{
+	const uint8_t* data = (const uint8_t*)report;
+	for (uint8_t i = 0; i < size; i++)
+		Endpoint_Write_8(data[i]);
+}
+
+// return: a whole report was in the bank?
+static inline bool ReadEndpointReport(void* const report, const uint8_t size)
+{
+	if (Endpoint_BytesInEndpoint() < size)
+		return false;
+
+	uint8_t* data = (uint8_t*)report;
+	for (uint8_t i = 0; i < size; i++)
+		data[i] = Endpoint_Read_8();
+	return true;
+}
+
 // Process and deliver data from IN and OUT endpoints.
+// Returns right away when an endpoint isn't ready, so a stalled host doesn't stall the main loop.
 void HID_Task(void) {
 	// If the device isn't connected and properly configured, we can't do anything here.
 	if (USB_DeviceState != DEVICE_STATE_Configured)
@@ -158,10 +346,13 @@ void HID_Task(void) {
 			// We'll create a place to store our data received from the host.
 			USB_JoystickReport_Output_t JoystickOutputData;
 			// We'll then take in that data, setting it up in our storage.
-			while(Endpoint_Read_Stream_LE(&JoystickOutputData, sizeof(JoystickOutputData), NULL) != ENDPOINT_RWSTREAM_NoError);
-			// At this point, we can react to this data.
-
-			// However, since we're not doing anything with this data, we abandon it.
+			// A short packet isn't a report, so it's dropped along with the rest of the bank.
+			if (ReadEndpointReport(&JoystickOutputData, sizeof(JoystickOutputData)))
+			{
+				// At this point, we can react to this data.
+				// We don't, but the PC may want to.
+				ForwardOutputReport(&JoystickOutputData);
+			}
 		}
 		// Regardless of whether we reacted to the data, we acknowledge an OUT packet on this endpoint.
 		Endpoint_ClearOUT();
@@ -169,17 +360,49 @@ void HID_Task(void) {
 
 	// We'll then move on to the IN endpoint.
 	Endpoint_SelectEndpoint(JOYSTICK_IN_EPADDR);
+	#ifdef PROFILE
+	CountMissedPolls();
+	#endif
 	// We first check to see if the host is ready to accept data.
 	if (Endpoint_IsINReady())
 	{
+		// The bank is free again, so the host has taken the last report.
+		if (is_report_in_bank)
+		{
+			CountTakenReport();
+			is_report_in_bank = false;
+		}
+		if (is_latency_in_flight)
+		{
+			AddLatency(&poll_latency, GetCycles() - in_flight_cycles);
+			is_latency_in_flight = false;
+		}
+		const bool is_measured = is_latency_pending;
+		is_latency_pending = false;
+
 		// We'll create an empty report.
 		USB_JoystickReport_Input_t JoystickInputData;
 		// We'll then populate this report with what we want to send to the host.
+		PROFILE_BEGIN(report_start);
 		GetNextReport(&JoystickInputData);
-		// Once populated, we can output this data to the host. We do this by first writing the data to the control stream.
-		while(Endpoint_Write_Stream_LE(&JoystickInputData, sizeof(JoystickInputData), NULL) != ENDPOINT_RWSTREAM_NoError);
+		PROFILE_END(PROFILE_GET_NEXT_REPORT, report_start);
+		// tell the PC as soon as playing has freed slots, since nothing else may come back
+		// (after the frame being sent, so that this never waits on the serial line)
+		if (is_credit_mode && !IsFrameSending() && InputQueueFreeSlots() > advertised_credits)
+			SendCredits();
+		// Once populated, we can output this data to the host. We do this by first writing the data to the free bank.
+		PROFILE_BEGIN(write_start);
+		WriteEndpointReport(&JoystickInputData, sizeof(JoystickInputData));
 		// We then send an IN packet on this endpoint.
 		Endpoint_ClearIN();
+		PROFILE_END(PROFILE_ENDPOINT_WRITE, write_start);
+		is_report_in_bank = true;
+
+		if (is_measured)
+		{
+			in_flight_cycles = parsed_cycles;
+			is_latency_in_flight = true;
+		}
 	}
 }
 
@@ -201,37 +424,254 @@ typedef enum {
 	NONE,		// do nothing
 
 	// On MCU
-	MASH_A,		// mash button A
-	AUTO_LEAGUE,// auto league
-	INF_WATT, 	// infinity watt
-	P_SYNC,
-	P_UNSYNC,
-	DEBUG,
-	DEBUG2,
+	TABLE,		// play an entry of command_registry[]
+	MACRO,		// play a macro uploaded to EEPROM
 
 	// From PC
 	PC_CALL,
+	PC_QUEUE,	// play reports queued by PC
 } Proc_State_t;
 Proc_State_t proc_state = NONE;
 
-char* cmd_name[MAX_BUFFER] = {
-	"mash_a",
-	"auto_league",
-	"inf_watt",
-	"sync",
-	"unsync"
-};
+// A report sent to be played at once ends the queued ones; what's left of them
+// would otherwise play first when the PC queues reports again.
+static inline void StopInputQueue(void)
+{
+	if (proc_state == PC_QUEUE)
+		ClearInputQueue();
+}
+
+TableEntry_t cur_table;
+
+void SelectTable(const int index)
+{
+	memcpy_P(&cur_table, &command_registry[index], sizeof(TableEntry_t));
+	proc_state = TABLE;
+}
 
 int step_index;
-int duration_count;
+uint32_t duration_count;
+uint32_t duration_polls; // of the step, taken when its first poll is counted
 
 Command cur_command;
-int duration_buf;
-int step_size_buf;
+uint16_t duration_buf;
+uint16_t step_start_ms;
+
+// Bytecode interpreter state (see Commands.h)
+typedef struct {
+	Subroutine_t callee;
+	int return_index;     // step_index of the caller
+	uint8_t repeat_depth; // loops of the caller
+	uint8_t deep_loops;   // loops of the caller past MAX_REPEAT_DEPTH
+} CallFrame_t;
+CallFrame_t call_stack[MAX_CALL_DEPTH];
+uint8_t call_depth = 0;
+
+typedef struct {
+	int start_index;    // the first command in the loop
+	uint16_t remaining; // times left after this one
+} RepeatFrame_t;
+RepeatFrame_t repeat_stack[MAX_REPEAT_DEPTH];
+uint8_t repeat_depth = 0;
+// Loops nested past MAX_REPEAT_DEPTH have no frame, so their OP_END must not pop one
+uint8_t deep_loops = 0;
+// Nesting of the { OP_REPEAT, 0 } body being skipped (0 when not skipping)
+uint8_t skip_depth = 0;
+
+// Sticks set by OP_STICK_L/R for the next report
+bool is_stick_l_set = false;
+bool is_stick_r_set = false;
+uint16_t stick_l, stick_r;
 
 uint8_t pc_lx, pc_ly, pc_rx, pc_ry;
 
-void ParseLine(char* line)
+// Macro playing from EEPROM
+const Command* macro_commands;
+uint8_t macro_size;
+bool is_macro_oneshot = false; // stop at the end instead of starting over
+
+// Binary frame receiving
+typedef enum {
+	FRAME_IDLE,
+	FRAME_LEN,
+	FRAME_TYPE,
+	FRAME_PAYLOAD,
+	FRAME_SUM
+} FrameState_t;
+FrameState_t frame_state = FRAME_IDLE;
+bool is_binary_mode = false;
+
+uint8_t frame_len;
+uint8_t frame_type;
+uint8_t frame_pos;
+uint8_t frame_sum;
+
+// Replies to the PC
+bool is_echo_mode = false; // echo every received character back
+bool is_ack_mode = false;  // reply ACK/NAK with a sequence number to every line and frame
+uint8_t ack_seq = 0;
+
+void Acknowledge(const bool accepted)
+{
+	if (!is_ack_mode)
+		return;
+
+	FinishFrame();
+	Serial_SendByte((accepted ? PROTO_SEQ_ACK : PROTO_SEQ_NAK) | ack_seq);
+	ack_seq = (ack_seq + 1) & PROTO_SEQ_MASK;
+
+	if (is_credit_mode)
+		SendCredits();
+}
+
+// return: the second word of the line isn't "off"?
+bool IsSwitchOn(const char* const line)
+{
+	char arg[4] = "";
+	sscanf(line, "%*s %3s", arg);
+	return strncmp(arg, "off", 4) != 0;
+}
+
+// Keywords without arguments, matched by HashName() like the tables in command_registry[]
+#define KEYWORD_END    0x6F1C // "end"
+#define KEYWORD_BINARY 0x9CCA // "binary"
+
+// The rest of ParseLine(), for a first word that isn't a table name
+// return: the line has been accepted?
+static bool ParseKeyword(const char* const cmd, const uint16_t hash, char* line)
+{
+	if (hash == KEYWORD_END) {
+		proc_state = NONE;
+		ResetDirections();
+		ClearInputQueue();
+	} else if (hash == KEYWORD_BINARY) {
+		// handshake: accept binary frames from now on
+		is_binary_mode = true;
+		Serial_SendByte(PROTO_ACK);
+		return true;
+	} else if (strncmp(cmd, "stats", 16) == 0) {
+		// "stats reset" starts the latency samples over instead
+		char arg[8] = "";
+		sscanf(line, "%*s %7s", arg);
+		if (strncmp(arg, "reset", 8) == 0)
+		{
+			ResetLatency(&parse_latency);
+			ResetLatency(&poll_latency);
+		}
+		else
+			PrintStats();
+		return true;
+#ifdef PROFILE
+	} else if (strncmp(cmd, "profile", 16) == 0) {
+		// "profile reset" starts over
+		char arg[8] = "";
+		sscanf(line, "%*s %7s", arg);
+		if (strncmp(arg, "reset", 8) == 0)
+			ResetProfile();
+		else
+			PrintProfile();
+		return true;
+#endif
+	} else if (strncmp(cmd, "baud", 16) == 0) {
+		unsigned long baud = 0;
+		sscanf(line, "%*s %lu", &baud);
+		return ChangeBaudRate(baud);
+	} else if (strncmp(cmd, "ack", 16) == 0) {
+		// the reply to this line is the first ACK
+		is_ack_mode = IsSwitchOn(line);
+		ack_seq = 0;
+		if (!is_ack_mode)
+		{
+			is_credit_mode = false;
+			is_output_mode = false;
+		}
+		return true;
+	} else if (strncmp(cmd, "credit", 16) == 0) {
+		// credits ride on the replies, so they need the ACK mode
+		if (!is_ack_mode)
+			return false;
+		is_credit_mode = IsSwitchOn(line);
+		return true;
+	} else if (strncmp(cmd, "output", 16) == 0) {
+		// only the reader of the ACK mode splits frames from the replies
+		if (!is_ack_mode)
+			return false;
+		is_output_mode = IsSwitchOn(line);
+		// the next OUT report is forwarded even if the host repeats the last one
+		is_output_forwarded = false;
+		return true;
+	} else if (strncmp(cmd, "rate", 16) == 0) {
+		// format [rate | rate <ms>]: show the report rate, or pick another profile and enumerate again
+		unsigned int interval_ms = 0;
+		if (sscanf(line, "%*s %u", &interval_ms) < 1)
+		{
+			PrintPollRate();
+			return true;
+		}
+		if (interval_ms > UINT8_MAX || !SetPollRate(interval_ms))
+			return false;
+		// the host reads the descriptors again as if the controller had been plugged in
+		USB_Disable();
+		USB_Init();
+		return true;
+	} else if (strncmp(cmd, "echo", 16) == 0) {
+		is_echo_mode = IsSwitchOn(line);
+		return true;
+#ifdef ALERT_WHEN_DONE
+	} else if (strncmp(cmd, "alert", 16) == 0) {
+		// format [alert done | alert error | alert sync | alert off], so the PC can signal too
+		char arg[6] = "";
+		sscanf(line, "%*s %5s", arg);
+		if (strncmp(arg, "done", 6) == 0)
+			StartAlert(ALERT_DONE);
+		else if (strncmp(arg, "error", 6) == 0)
+			StartAlert(ALERT_ERROR);
+		else if (strncmp(arg, "sync", 6) == 0)
+			StartAlert(ALERT_SYNC_LOST);
+		else if (strncmp(arg, "off", 6) == 0)
+			StopAlert();
+		else
+			return false;
+		return true;
+#endif
+	} else if (strncmp(cmd, "macro", 16) == 0) {
+		// format [macro list | macro play <slot> [once] | macro del <slot>]
+		char sub[5] = "";
+		unsigned int slot = MACRO_SLOTS;
+		char mode[5] = "";
+		sscanf(line, "%*s %4s %u %4s", sub, &slot, mode);
+
+		if (strncmp(sub, "list", 5) == 0) {
+			PrintMacros();
+			return true;
+		} else if (strncmp(sub, "del", 5) == 0) {
+			// deleting moves other macros too
+			if (proc_state == MACRO)
+				proc_state = NONE;
+			return DeleteMacro(slot);
+		} else if (strncmp(sub, "play", 5) == 0) {
+			// an empty slot leaves the macro playing now alone
+			const uint8_t size = GetMacroSize(slot);
+			if (size == 0)
+				return false;
+
+			macro_size = size;
+			macro_commands = GetMacroCommands(slot);
+			is_macro_oneshot = strncmp(mode, "once", 5) == 0;
+			proc_state = MACRO;
+		} else {
+			return false;
+		}
+	} else {
+		SelectTable(REGISTRY_UNKNOWN);
+	}
+
+	ResetSteps();
+	return true;
+}
+
+// return: the line has been accepted?
+bool ParseLine(char* line)
 {
 	char cmd[16];
 	uint16_t p_btns;
@@ -239,14 +679,14 @@ void ParseLine(char* line)
 
 	// get command
 	int ret = sscanf(line, "%s", cmd);
+	// the replies to some commands are printed
+	FinishFrame();
 
 	if (ret == EOF) {
-		proc_state = DEBUG;
-	} else if (strncmp(cmd, "end", 16) == 0) {
-		proc_state = NONE;
-		ResetDirections();
+		SelectTable(REGISTRY_EMPTY_LINE);
 	} else if (cmd[0] >= '0' && cmd[0] <= '9') {
-		memset(&pc_report, 0, sizeof(uint16_t));
+		USB_JoystickReport_Input_t* const report = BeginPCReport();
+		report->Button = 0;
 
 		// format [button LeftStickX LeftStickY RightStickX RightStickY HAT] 
 		// button: Y | B | A | X | L | R | ZL | ZR | MINUS | PLUS | LCLICK | RCLICK | HOME | CAP
@@ -256,7 +696,7 @@ void ParseLine(char* line)
 				&pc_lx, &pc_ly, &pc_rx, &pc_ry);
 
 		// HAT : 0(TOP) to 7(TOP_LEFT) in clockwise | 8(CENTER)
-		pc_report.HAT = hat;
+		report->HAT = hat;
 
 		// we use bit array for buttons(2 Bytes), which last 2 bits are flags of directions
 		bool use_right = p_btns & 0x1;
@@ -264,81 +704,458 @@ void ParseLine(char* line)
 
 		// Left stick
 		if (use_left) {
-			pc_report.LX = pc_lx;
-			pc_report.LY = pc_ly;
+			report->LX = pc_lx;
+			report->LY = pc_ly;
 		}
 
 		// Right stick
 		if (use_right & use_left) {
-			pc_report.RX = pc_rx;
-			pc_report.RY = pc_ry;
+			report->RX = pc_rx;
+			report->RY = pc_ry;
 		} else if (use_right) {
-			pc_report.RX = pc_lx;
-			pc_report.RY = pc_ly;
+			report->RX = pc_lx;
+			report->RY = pc_ly;
 		}
 
 		p_btns >>= 2;
-		pc_report.Button |= p_btns;
+		report->Button |= p_btns;
+		PublishPCReport();
 
+		StopInputQueue();
 		proc_state = PC_CALL;
-	} else if (strncmp(cmd, cmd_name[0], 16) == 0) {
-		proc_state = MASH_A;
-	} else if (strncmp(cmd, cmd_name[1], 16) == 0) {
-		proc_state = AUTO_LEAGUE;
-	} else if (strncmp(cmd, cmd_name[2], 16) == 0) {
-		proc_state = INF_WATT;
-	} else if (strncmp(cmd, cmd_name[3], 16) == 0) {
-		proc_state = P_SYNC;
-	} else if (strncmp(cmd, cmd_name[4], 16) == 0) {
-		proc_state = P_UNSYNC;
+		is_report_updated = true;
 	} else {
-		proc_state = DEBUG2;
+		// names of tables come far more often than keywords, so they're looked up first
+		const uint16_t hash = HashName(cmd);
+		const int index = FindTable(hash);
+		if (index < 0)
+			return ParseKeyword(cmd, hash, line);
+		SelectTable(index);
 	}
 
-	step_index = 0;
-	step_size_buf = INT8_MAX;
-	duration_buf = 0;
+	ResetSteps();
+	return true;
+}
+
+QueueEntry_t queue_entry;
+uint16_t queue_overflow_count = 0;
+
+// Unpack [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY]
+void ReadFrameReport(const uint8_t* const payload, USB_JoystickReport_Input_t* const report)
+{
+	report->Button = payload[0] | (payload[1] << 8);
+	report->HAT = payload[2];
+	report->LX = payload[3];
+	report->LY = payload[4];
+	report->RX = payload[5];
+	report->RY = payload[6];
+	report->VendorSpec = 0;
+}
+
+// Apply FRAME_DELTA ops to the PC report
+// return: every op was valid? (nothing is changed otherwise)
+bool ApplyDelta(const uint8_t* const payload, const uint8_t len)
+{
+	USB_JoystickReport_Input_t* const report = BeginPCReport();
+
+	for (uint8_t i = 0; i < len; )
+	{
+		const uint8_t op = payload[i++];
+		const uint8_t args = op == DELTA_HAT ? 1 : 2;
+		if (i + args > len)
+			return false;
+
+		switch (op)
+		{
+			case DELTA_BUTTONS_SET:
+				report->Button |= payload[i] | (payload[i + 1] << 8);
+				break;
+
+			case DELTA_BUTTONS_CLEAR:
+				report->Button &= ~(payload[i] | (payload[i + 1] << 8));
+				break;
+
+			case DELTA_HAT:
+				report->HAT = payload[i];
+				break;
+
+			case DELTA_STICK_L:
+				report->LX = payload[i];
+				report->LY = payload[i + 1];
+				break;
+
+			case DELTA_STICK_R:
+				report->RX = payload[i];
+				report->RY = payload[i + 1];
+				break;
+
+			default:
+				return false;
+		}
+		i += args;
+	}
+
+	PublishPCReport();
+	return true;
+}
+
+// return: the frame has been accepted?
+bool ParseFrame(const uint8_t type, const uint8_t* const payload, const uint8_t len)
+{
+	switch (type)
+	{
+		case FRAME_REPORT:
+			if (len != 7)
+				return false;
+
+			// the whole report is sent every time, so no stick flags are needed here
+			ReadFrameReport(payload, BeginPCReport());
+			PublishPCReport();
+
+			StopInputQueue();
+			proc_state = PC_CALL;
+			is_report_updated = true;
+			break;
+
+		case FRAME_QUEUE:
+			if (len != 9)
+				return false;
+
+			// keep playing without resetting the current entry
+			ReadFrameReport(payload, &queue_entry.report);
+			queue_entry.polls = payload[7] | (payload[8] << 8);
+			if (queue_entry.polls == QUEUE_REPEAT_MARK)
+				queue_entry.polls = 1;
+
+			proc_state = PC_QUEUE;
+			if (!PushInputQueue(&queue_entry))
+			{
+				queue_overflow_count++;
+				StartAlert(ALERT_ERROR);
+				return false;
+			}
+			return true;
+
+		case FRAME_QUEUE_REPEAT:
+			if (len != 3)
+				return false;
+
+			proc_state = PC_QUEUE;
+			if (!PushInputQueueRepeat(payload[0] | (payload[1] << 8), payload[2]))
+			{
+				queue_overflow_count++;
+				StartAlert(ALERT_ERROR);
+				return false;
+			}
+			return true;
+
+		case FRAME_DELTA:
+			if (!ApplyDelta(payload, len))
+				return false;
+
+			StopInputQueue();
+			proc_state = PC_CALL;
+			is_report_updated = true;
+			break;
+
+		case FRAME_MACRO_BEGIN:
+			if (len != 2)
+				return false;
+
+			// the pool is going to be rearranged
+			if (proc_state == MACRO)
+				proc_state = NONE;
+			return BeginMacro(payload[0], payload[1]);
+
+		case FRAME_MACRO_DATA:
+			return AppendMacro(payload, len);
+
+		case FRAME_MACRO_COMMIT:
+			return len == 0 && CommitMacro();
+
+		default:
+			return false;
+	}
+
+	ResetSteps();
+	return true;
+}
+
+// return: the byte has been consumed as a part of a binary frame?
+bool ReceiveFrameByte(const uint8_t c)
+{
+	switch (frame_state)
+	{
+		case FRAME_IDLE:
+			// a frame can start only where a text line could
+			if (!is_binary_mode || idx != 0 || c != FRAME_SYNC)
+				return false;
+
+			frame_state = FRAME_LEN;
+			break;
+
+		case FRAME_LEN:
+			frame_len = c;
+			frame_sum = c;
+			frame_state = FRAME_TYPE;
+
+			if (frame_len > FRAME_MAX_PAYLOAD)
+			{
+				Acknowledge(false);
+				frame_state = FRAME_IDLE;
+			}
+			break;
+
+		case FRAME_TYPE:
+			frame_type = c;
+			frame_sum += c;
+			frame_pos = 0;
+			frame_state = frame_len > 0 ? FRAME_PAYLOAD : FRAME_SUM;
+			break;
+
+		case FRAME_PAYLOAD:
+			// the line buffer is free while a frame is being received
+			pc_report_str[frame_pos++] = c;
+			frame_sum += c;
+			if (frame_pos >= frame_len)
+				frame_state = FRAME_SUM;
+			break;
+
+		case FRAME_SUM:
+		{
+			PROFILE_BEGIN(parse_start);
+			const bool accepted = c == frame_sum && ParseFrame(frame_type, (uint8_t*)pc_report_str, frame_len);
+			PROFILE_END(PROFILE_PARSE_FRAME, parse_start);
+			Acknowledge(accepted);
+
+			memset(pc_report_str, 0, sizeof(pc_report_str));
+			frame_state = FRAME_IDLE;
+			break;
+		}
+	}
+
+	return true;
 }
 
+// The RX interrupt only pushes bytes into this ring buffer.
+// It is the only producer and SerialTask() is the only consumer, so no locking is needed.
+#define RX_BUFFER_SIZE 64 // must be a power of 2
+volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
+volatile uint8_t rx_head = 0;
+volatile uint8_t rx_tail = 0;
+
+// When the RX interrupt received the last byte of a line or a frame, and where it is in rx_buffer
+// One slot is enough as SerialTask() stops at every complete one; a later end overwrites it,
+// and the input it ended goes untimed.
+volatile uint32_t rx_end_cycles;
+volatile uint8_t rx_end_index = RX_BUFFER_SIZE; // none
+// Bytes left of the frame being received, as far as the interrupt can tell
+// (FRAME_SYNC starts one, as text never has the top bit set)
+uint8_t rx_frame_left = 0;
+bool is_rx_frame_len_next = false;
+
+// Dropped input counters (shown by "stats")
+volatile uint16_t rx_overflow_count = 0; // the ring buffer was full
+uint16_t line_overflow_count = 0;        // the line was longer than MAX_BUFFER
+bool is_line_overflow = false;
+
 ISR(USART1_RX_vect) 
 {
+	PROFILE_BEGIN(isr_start);
 	// one character comes at a time
-	char c = fgetc(stdin);
-	if (Serial_IsSendReady()) 
+	uint8_t c = UDR1;
+	uint8_t next = (rx_head + 1) & (RX_BUFFER_SIZE - 1);
+
+	if (next == rx_tail)
+	{
+		rx_overflow_count++;
+		PROFILE_END(PROFILE_RX_ISR, isr_start);
+		return;
+	}
+
+	// find where lines and frames end: '\r', or the SUM of the LEN the frame gave
+	bool is_end = false;
+	if (is_rx_frame_len_next)
+	{
+		is_rx_frame_len_next = false;
+		// TYPE, the payload and SUM
+		rx_frame_left = c <= FRAME_MAX_PAYLOAD ? c + 2 : 0;
+	}
+	else if (rx_frame_left > 0)
+		is_end = --rx_frame_left == 0;
+	else if (c == FRAME_SYNC)
+		is_rx_frame_len_next = true;
+	else
+		is_end = c == '\r';
+
+	if (is_end)
+	{
+		rx_end_cycles = GetCycles();
+		rx_end_index = rx_head;
+	}
+	rx_buffer[rx_head] = c;
+	rx_head = next;
+	PROFILE_END(PROFILE_RX_ISR, isr_start);
+}
+
+// return: a line or a frame has been completed?
+bool ReceiveByte(const char c)
+{
+	if (ReceiveFrameByte(c))
+		return frame_state == FRAME_IDLE;
+
+	if (is_echo_mode && !IsFrameSending() && Serial_IsSendReady()) 
 		printf("%c", c);
 
 	if (c == '\r') 
 	{
-		ParseLine(pc_report_str);
+		// a truncated line would be misread, so drop it
+		PROFILE_BEGIN(parse_start);
+		const bool accepted = !is_line_overflow && ParseLine(pc_report_str);
+		PROFILE_END(PROFILE_PARSE_LINE, parse_start);
+		Acknowledge(accepted);
+		is_line_overflow = false;
 		idx = 0;
 		memset(pc_report_str, 0, sizeof(pc_report_str));
+		return true;
 	} 
-	else if (c != '\n' && idx < MAX_BUFFER)
-		pc_report_str[idx++] = c;
+	else if (c != '\n')
+	{
+		// keep the last byte for the terminator
+		if (idx < MAX_BUFFER - 1)
+			pc_report_str[idx++] = c;
+		else
+		{
+			line_overflow_count++;
+			if (!is_line_overflow)
+				StartAlert(ALERT_ERROR);
+			is_line_overflow = true;
+		}
+	}
+
+	return false;
+}
+
+// Assemble and parse serial input received by the RX interrupt.
+void SerialTask(void)
+{
+	// stop at the first complete command so that HID_Task() runs in between
+	// Input after a macro upload or delete waits in the ring buffer until MacroTask() has
+	// written it all, as what comes next may read the pool.
+	while (rx_tail != rx_head && !IsMacroWriting())
+	{
+		const uint8_t index = rx_tail;
+		char c = rx_buffer[index];
+		rx_tail = (rx_tail + 1) & (RX_BUFFER_SIZE - 1);
+
+		if (ReceiveByte(c))
+		{
+			if (is_report_updated)
+			{
+				uint32_t end_cycles;
+				bool is_timed;
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+				{
+					end_cycles = rx_end_cycles;
+					is_timed = rx_end_index == index;
+				}
+
+				parsed_cycles = GetCycles();
+				if (is_timed)
+					AddLatency(&parse_latency, parsed_cycles - end_cycles);
+				is_latency_pending = true;
+				is_report_updated = false;
+			}
+			break;
+		}
+	}
+}
+
+void InitSerial(const uint32_t baud)
+{
+	// 9600 keeps the single speed setting it has always used
+	Serial_Init(baud, baud > 9600);
+	UCSR1B |= (1 << RXCIE1);
+}
+
+// return: the baud rate has been changed?
+bool ChangeBaudRate(const uint32_t baud)
+{
+	// accept only rates the 16 MHz clock can generate with a small error in double speed mode
+	switch (baud)
+	{
+		case 9600:
+		case 19200:
+		case 38400:
+		case 57600:
+		case 115200:
+		case 250000:
+		case 500000:
+		case 1000000:
+			break;
+
+		default:
+			Serial_SendByte(PROTO_NAK);
+			return false;
+	}
+
+	// acknowledge at the old rate and wait until the ACK has been shifted out
+	UCSR1A |= (1 << TXC1);
+	Serial_SendByte(PROTO_ACK);
+	while (!Serial_IsSendComplete());
+
+	InitSerial(baud);
+
+	// bytes received during the switch are garbage
+	rx_tail = rx_head;
+	rx_frame_left = 0;
+	is_rx_frame_len_next = false;
+	return true;
+}
+
+void PrintStats(void)
+{
+	uint16_t rx_overflow;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		rx_overflow = rx_overflow_count;
+	}
+
+	printf("rx_overflow %u line_overflow %u queue_overflow %u\r\n",
+		rx_overflow, line_overflow_count, queue_overflow_count);
+
+	// min/avg/max in microseconds
+	printf("latency_us ");
+	PrintLatency("parse", &parse_latency);
+	printf(" ");
+	PrintLatency("poll", &poll_latency);
+	printf(" samples %u\r\n", poll_latency.count);
 }
 
 
 USB_JoystickReport_Input_t last_report;
-const int echo_ratio = 3; // for compatiblity
+
+#ifdef COMMAND_UNIT_MS
+// every duration is timed on the SOF clock
+#define IsMillisDuration(d) true
+#define MillisOfDuration(d) (((d) & DURATION_MS) ? ((d) & ~DURATION_MS) : (d) * COMMAND_UNIT_MS)
+#else
+#define IsMillisDuration(d) ((d) & DURATION_MS)
+#define MillisOfDuration(d) ((d) & ~DURATION_MS)
+#endif
 bool is_use_sync = false;
 
 // Prepare the next report for the host.
 void GetNextReport(USB_JoystickReport_Input_t* const ReportData) {
 
 	// Prepare an empty report
-	memset(ReportData, 0, sizeof(USB_JoystickReport_Input_t));
-	ReportData->LX = STICK_CENTER;
-	ReportData->LY = STICK_CENTER;
-	ReportData->RX = STICK_CENTER;
-	ReportData->RY = STICK_CENTER;
-	ReportData->HAT = HAT_CENTER;
+	ApplyButtonCommand(NOP, ReportData);
 
 	// States and moves management
 	switch (state)
 	{
 		case INIT:
-			step_index = 0;
-			step_size_buf = INT8_MAX;
+			ResetSteps();
 
 			state = is_use_sync ? SYNC : PROCESS;
 			break;
@@ -356,41 +1173,37 @@ void GetNextReport(USB_JoystickReport_Input_t* const ReportData) {
 				case NONE:
 					break;
 
-				case MASH_A:
-					GetNextReportFromCommands(mash_a_commands, mash_a_size, ReportData);
-					break;
-				
-				case AUTO_LEAGUE:
-					GetNextReportFromCommands(auto_league_commands, auto_league_size, ReportData);
-					ReportData->LX = 172;
-					ReportData->LY = 7;
-					break;
-
-				case INF_WATT:
-					GetNextReportFromCommands(inf_watt_commands, inf_watt_size, ReportData);
-					break;
-				
-				case P_SYNC:
-					if (!GetNextReportFromCommands(sync, sync_size, ReportData))
+				case TABLE:
+					if (!GetNextReportFromCommands(cur_table.commands, cur_table.size, ReportData)
+						&& (cur_table.flags & TABLE_ONESHOT))
+					{
 						proc_state = NONE;
+						StartAlert(ALERT_DONE);
+					}
+
+					if (cur_table.flags & TABLE_FIXED_STICK)
+					{
+						ReportData->LX = cur_table.lx;
+						ReportData->LY = cur_table.ly;
+					}
 					break;
 
-				case P_UNSYNC:
-					if (!GetNextReportFromCommands(unsync, unsync_size, ReportData))
+				case MACRO:
+					if (!GetNextReportFromMacro(macro_commands, macro_size, ReportData) && is_macro_oneshot)
+					{
 						proc_state = NONE;
-					break;
-				
-				case DEBUG:
-					GetNextReportFromCommands(mash_x_commands, mash_x_size, ReportData);
-					break;
-
-				case DEBUG2:
-					GetNextReportFromCommands(mash_home_commands, mash_home_size, ReportData);
+						StartAlert(ALERT_DONE);
+					}
 					break;
 
 				case PC_CALL:
 					// copy a report that was sent from PC
-					memcpy(ReportData, &pc_report, sizeof(USB_JoystickReport_Input_t));
+					ReadPCReport(ReportData);
+					break;
+
+				case PC_QUEUE:
+					// pop reports on exact poll boundaries
+					GetNextReportFromQueue(ReportData);
 					break;
 
 				default:
@@ -400,16 +1213,11 @@ void GetNextReport(USB_JoystickReport_Input_t* const ReportData) {
 			break;
 
 		case CLEANUP:
+			StartAlert(ALERT_DONE); //flash LED(s) and sound buzzer if attached
 			state = DONE;
 			break;
 
 		case DONE:
-			#ifdef ALERT_WHEN_DONE
-			portsval = ~portsval;
-			PORTD = portsval; //flash LED(s) and sound buzzer if attached
-			PORTB = portsval;
-			_delay_ms(250);
-			#endif
 			return;
 	}
 }
@@ -420,130 +1228,278 @@ bool GetNextReportFromCommands(
 	const int step_size, 
 	USB_JoystickReport_Input_t* const ReportData)
 {
-	// Repeat the last report at duration times
-	// duration_buf is mul by the ratio for concerning compatibility with code using echo variables
-	if (duration_count++ < duration_buf * echo_ratio)
-	{
-		memcpy(ReportData, &last_report, sizeof(USB_JoystickReport_Input_t));
-		return true;
-	}
+	return GetNextReportFromSource(commands, false, step_size, ReportData);
+}
+
+bool GetNextReportFromMacro(
+	const Command* const commands, 
+	const int step_size, 
+	USB_JoystickReport_Input_t* const ReportData)
+{
+	return GetNextReportFromSource(commands, true, step_size, ReportData);
+}
+
+void ResetSteps(void)
+{
+	step_index = 0;
+	duration_buf = 0;
+	duration_count = 0;
+	call_depth = 0;
+	repeat_depth = 0;
+	deep_loops = 0;
+	skip_depth = 0;
+	is_stick_l_set = false;
+	is_stick_r_set = false;
+}
+
+void FetchCommand(const Command* const table, const bool is_eeprom, Command* const command)
+{
+	if (is_eeprom)
+		eeprom_read_block(command, &table[step_index++], sizeof(Command));
 	else
+		memcpy_P(command, &table[step_index++], sizeof(Command));
+}
+
+// return: the command was an opcode, and the next one should be fetched?
+bool ExecuteOpcode(const Command* const command)
+{
+	Subroutine_t callee;
+
+	// everything up to the matching OP_END is passed over, PRESS entries included
+	if (skip_depth > 0)
 	{
-		duration_count = 0;		
+		if (command->button == OP_REPEAT)
+			skip_depth++;
+		else if (command->button == OP_END)
+			skip_depth--;
+		return true;
 	}
 
-	// Check step size range
-	if (step_index > step_size_buf - 1)
+	switch (command->button)
 	{
-		step_index = 0; // go back to first step
-
-		ReportData->LX = STICK_CENTER;
-		ReportData->LY = STICK_CENTER;
-		ReportData->RX = STICK_CENTER;
-		ReportData->RY = STICK_CENTER;
-		ReportData->HAT = HAT_CENTER;
+		case OP_REPEAT:
+			if (command->duration == 0)
+				skip_depth = 1;
+			else if (repeat_depth < MAX_REPEAT_DEPTH)
+			{
+				repeat_stack[repeat_depth].start_index = step_index;
+				repeat_stack[repeat_depth].remaining = command->duration - 1;
+				repeat_depth++;
+			}
+			else
+				deep_loops++; // runs only once
+			return true;
+
+		case OP_END:
+			if (deep_loops > (call_depth > 0 ? call_stack[call_depth - 1].deep_loops : 0))
+				deep_loops--;
+			// loops of the caller are out of reach
+			else if (repeat_depth > (call_depth > 0 ? call_stack[call_depth - 1].repeat_depth : 0))
+			{
+				RepeatFrame_t* const loop = &repeat_stack[repeat_depth - 1];
+				if (loop->remaining > 0)
+				{
+					loop->remaining--;
+					step_index = loop->start_index;
+				}
+				else
+					repeat_depth--;
+			}
+			return true;
+
+		case OP_CALL:
+			if (call_depth >= MAX_CALL_DEPTH || command->duration >= subroutines_size)
+				return true;
+
+			memcpy_P(&callee, &subroutines[command->duration], sizeof(Subroutine_t));
+			call_stack[call_depth].callee = callee;
+			call_stack[call_depth].return_index = step_index;
+			call_stack[call_depth].repeat_depth = repeat_depth;
+			call_stack[call_depth].deep_loops = deep_loops;
+			call_depth++;
+			step_index = 0;
+			return true;
 
-		memcpy(&last_report, ReportData, sizeof(USB_JoystickReport_Input_t)); // create echo report
-		return false;
-	}
+		case OP_STICK_L:
+			is_stick_l_set = true;
+			stick_l = command->duration;
+			return true;
 
-	// Get command from flash memory
-	memcpy_P(&cur_command, &commands[step_index++], sizeof(Command));
-	step_size_buf = step_size;
+		case OP_STICK_R:
+			is_stick_r_set = true;
+			stick_r = command->duration;
+			return true;
 
-	duration_buf = cur_command.duration;
-	ApplyButtonCommand(cur_command.button, ReportData);
+		case OP_RET:
+			if (call_depth > 0)
+			{
+				call_depth--;
+				step_index = call_stack[call_depth].return_index;
+				repeat_depth = call_stack[call_depth].repeat_depth;
+				deep_loops = call_stack[call_depth].deep_loops;
+			}
+			else
+				step_index = INT16_MAX; // to the end of the table
+			return true;
 
-	memcpy(&last_report, ReportData, sizeof(USB_JoystickReport_Input_t)); // create echo report
-	return true;
+		default:
+			return false;
+	}
 }
 
-void ApplyButtonCommand(const Buttons_t button, USB_JoystickReport_Input_t* const ReportData)
+// commands are in EEPROM if is_eeprom, otherwise in flash memory
+bool GetNextReportFromSource(
+	const Command* const commands, 
+	const bool is_eeprom,
+	const int step_size, 
+	USB_JoystickReport_Input_t* const ReportData)
 {
-	switch (button)
+	// Repeat the last report at duration times
+	if (IsMillisDuration(duration_buf))
 	{
-		case UP:
-			ReportData->LY = STICK_MIN;				
-			break;
-
-		case LEFT:
-			ReportData->LX = STICK_MIN;				
-			break;
-
-		case DOWN:
-			ReportData->LY = STICK_MAX;				
-			break;
+		// time the step on the SOF clock
+		if ((uint16_t)(GetMillis() - step_start_ms) < MillisOfDuration(duration_buf))
+		{
+			memcpy(ReportData, &last_report, sizeof(USB_JoystickReport_Input_t));
+			return true;
+		}
+	}
+	else
+	{
+		// a unit is as many polls as the report rate profile takes for the same time
+		if (duration_count == 0)
+			duration_polls = PollsOfUnits(duration_buf);
+		if (duration_count++ < duration_polls)
+		{
+			memcpy(ReportData, &last_report, sizeof(USB_JoystickReport_Input_t));
+			return true;
+		}
+	}
 
-		case RIGHT:
-			ReportData->LX = STICK_MAX;				
-			break;
+	duration_count = 0;
+	step_start_ms = GetMillis();
 
-		case A:
-			ReportData->Button |= SWITCH_A;
-			break;
+	// Run opcodes until a command that makes a report
+	const Command* table;
+	int size;
+	bool is_table_eeprom;
+	for (uint8_t ops = 0; ; ops++)
+	{
+		// subroutines are always in flash memory
+		table = commands;
+		size = step_size;
+		is_table_eeprom = is_eeprom;
+		if (call_depth > 0)
+		{
+			table = call_stack[call_depth - 1].callee.commands;
+			size = call_stack[call_depth - 1].callee.size;
+			is_table_eeprom = false;
+		}
 
-		case B:
-			ReportData->Button |= SWITCH_B;
-			break;
+		// Check step size range
+		if (step_index > size - 1)
+		{
+			// a body left unterminated is skipped up to the end of its table
+			skip_depth = 0;
+			if (call_depth > 0)
+			{
+				cur_command.button = OP_RET;
+				ExecuteOpcode(&cur_command);
+				continue;
+			}
 
-		case X:
-			ReportData->Button |= SWITCH_X;
-			break;
+			ResetSteps(); // go back to first step
 
-		case Y:
-			ReportData->Button |= SWITCH_Y;
-			break;
+			ReportData->LX = STICK_CENTER;
+			ReportData->LY = STICK_CENTER;
+			ReportData->RX = STICK_CENTER;
+			ReportData->RY = STICK_CENTER;
+			ReportData->HAT = HAT_CENTER;
 
-		case L:
-			ReportData->Button |= SWITCH_L;
-			break;
+			memcpy(&last_report, ReportData, sizeof(USB_JoystickReport_Input_t)); // create echo report
+			return false;
+		}
 
-		case R:
-			ReportData->Button |= SWITCH_R;
-			break;
+		// Get command from flash memory or EEPROM
+		FetchCommand(table, is_table_eeprom, &cur_command);
 
-		case TRIGGERS:
-			ReportData->Button |= SWITCH_L | SWITCH_R;
+		if (!ExecuteOpcode(&cur_command))
 			break;
 
-		case UPLEFT:
-			ReportData->LX = STICK_MIN;
-			ReportData->LY = STICK_MIN;
+		// a loop without a report would never let this poll finish
+		if (ops >= MAX_OPS_PER_STEP)
+		{
+			cur_command.button = OP_WAIT;
+			cur_command.duration = 0;
 			break;
+		}
+	}
 
-		case UPRIGHT:
-			ReportData->LX = STICK_MAX;
-			ReportData->LY = STICK_MIN;
-			break;	
-
-		case DOWNRIGHT:
-			ReportData->LX = STICK_MAX;
-			ReportData->LY = STICK_MAX;
-			break;
+	duration_buf = cur_command.duration;
+	if (cur_command.button == OP_WAIT)
+	{
+		memcpy(ReportData, &last_report, sizeof(USB_JoystickReport_Input_t));
+		return true;
+	}
 
-		case DOWNLEFT:
-			ReportData->LX = STICK_MIN;
-			ReportData->LY = STICK_MAX;
-			break;
+	if (cur_command.button == OP_PRESS)
+	{
+		// the buttons come with { HAT, duration }
+		ReportData->Button = cur_command.duration;
+		if (step_index < size)
+		{
+			FetchCommand(table, is_table_eeprom, &cur_command);
+			ReportData->HAT = cur_command.button;
+			duration_buf = cur_command.duration;
+		}
+	}
+	else
+		ApplyButtonCommand(cur_command.button, ReportData);
 
-		case PLUS:
-			ReportData->Button |= SWITCH_PLUS;
-			break;
+	if (is_stick_l_set)
+	{
+		ReportData->LX = stick_l & 0xFF;
+		ReportData->LY = stick_l >> 8;
+		is_stick_l_set = false;
+	}
+	if (is_stick_r_set)
+	{
+		ReportData->RX = stick_r & 0xFF;
+		ReportData->RY = stick_r >> 8;
+		is_stick_r_set = false;
+	}
 
-		case MINUS:
-			ReportData->Button |= SWITCH_MINUS;
-			break;
+	memcpy(&last_report, ReportData, sizeof(USB_JoystickReport_Input_t)); // create echo report
+	return true;
+}
 
-		case HOME:
-			ReportData->Button |= SWITCH_HOME;
-			break;
+// Reports made by the button commands, indexed by Buttons_t, so a step is one copy from flash
+#define BUTTON_REPORT(button, lx, ly) \
+	{ .Button = (button), .HAT = HAT_CENTER, .LX = (lx), .LY = (ly), .RX = STICK_CENTER, .RY = STICK_CENTER }
+const USB_JoystickReport_Input_t button_reports[HOME + 1] PROGMEM = {
+	[UP]        = BUTTON_REPORT(0, STICK_CENTER, STICK_MIN),
+	[DOWN]      = BUTTON_REPORT(0, STICK_CENTER, STICK_MAX),
+	[LEFT]      = BUTTON_REPORT(0, STICK_MIN, STICK_CENTER),
+	[RIGHT]     = BUTTON_REPORT(0, STICK_MAX, STICK_CENTER),
+	[UPLEFT]    = BUTTON_REPORT(0, STICK_MIN, STICK_MIN),
+	[UPRIGHT]   = BUTTON_REPORT(0, STICK_MAX, STICK_MIN),
+	[DOWNLEFT]  = BUTTON_REPORT(0, STICK_MIN, STICK_MAX),
+	[DOWNRIGHT] = BUTTON_REPORT(0, STICK_MAX, STICK_MAX),
+	[X]         = BUTTON_REPORT(SWITCH_X, STICK_CENTER, STICK_CENTER),
+	[Y]         = BUTTON_REPORT(SWITCH_Y, STICK_CENTER, STICK_CENTER),
+	[A]         = BUTTON_REPORT(SWITCH_A, STICK_CENTER, STICK_CENTER),
+	[B]         = BUTTON_REPORT(SWITCH_B, STICK_CENTER, STICK_CENTER),
+	[L]         = BUTTON_REPORT(SWITCH_L, STICK_CENTER, STICK_CENTER),
+	[R]         = BUTTON_REPORT(SWITCH_R, STICK_CENTER, STICK_CENTER),
+	[PLUS]      = BUTTON_REPORT(SWITCH_PLUS, STICK_CENTER, STICK_CENTER),
+	[MINUS]     = BUTTON_REPORT(SWITCH_MINUS, STICK_CENTER, STICK_CENTER),
+	[NOP]       = BUTTON_REPORT(0, STICK_CENTER, STICK_CENTER),
+	[TRIGGERS]  = BUTTON_REPORT(SWITCH_L | SWITCH_R, STICK_CENTER, STICK_CENTER),
+	[HOME]      = BUTTON_REPORT(SWITCH_HOME, STICK_CENTER, STICK_CENTER),
+};
 
-		default:
-			ReportData->LX = STICK_CENTER;
-			ReportData->LY = STICK_CENTER;
-			ReportData->RX = STICK_CENTER;
-			ReportData->RY = STICK_CENTER;
-			ReportData->HAT = HAT_CENTER;
-			break;
-	}
+// Replaces the whole report; anything that isn't a button command sends the empty one
+void ApplyButtonCommand(const Buttons_t button, USB_JoystickReport_Input_t* const ReportData)
+{
+	memcpy_P(ReportData, &button_reports[button <= HOME ? button : NOP], sizeof(USB_JoystickReport_Input_t));
 }
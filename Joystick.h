@@ -42,6 +42,8 @@
 #include <avr/power.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
 #include <string.h>
 
 #include <LUFA/Drivers/USB/USB.h>
@@ -127,6 +129,16 @@ typedef enum {
 	NOP,
 	TRIGGERS,
     HOME,
+
+	// Opcodes for command tables (see Commands.h); these take no time by themselves
+	OP_REPEAT,	// play the commands up to the matching OP_END 'duration' times
+	OP_END,
+	OP_CALL,	// play subroutines['duration'] and come back
+	OP_RET,		// go back to the caller (also done at the end of a subroutine)
+	OP_WAIT,	// keep sending the last report for 'duration'
+	OP_PRESS,	// press the JoystickButtons_t mask 'duration'; the next entry is { HAT, duration }
+	OP_STICK_L,	// move the left stick of the next report to 'duration' (LX | LY << 8)
+	OP_STICK_R,	// move the right stick of the next report to 'duration' (RX | RY << 8)
 } Buttons_t;
 
 // Function Prototypes
@@ -134,11 +146,24 @@ typedef enum {
 void SetupHardware(void);
 // Process and deliver data from IN and OUT endpoints.
 void HID_Task(void);
+// Assemble and parse serial input received by the RX interrupt.
+void SerialTask(void);
+// Send the OUT report forwarded last, without waiting on the serial line.
+void OutputTask(void);
+// Print diagnostic counters to the serial port.
+void PrintStats(void);
+// Initialize the USART at the given baud rate with the RX interrupt enabled.
+void InitSerial(const uint32_t baud);
+// Acknowledge a "baud" request and switch to the requested baud rate.
+bool ChangeBaudRate(const uint32_t baud);
 // USB device event handlers.
 void EVENT_USB_Device_Connect(void);
 void EVENT_USB_Device_Disconnect(void);
 void EVENT_USB_Device_ConfigurationChanged(void);
 void EVENT_USB_Device_ControlRequest(void);
+void EVENT_USB_Device_StartOfFrame(void);
+// Milliseconds counted by USB SOF packets (wraps around every 65.5 s).
+uint16_t GetMillis(void);
 // Prepare the next report for the host.
 void GetNextReport(USB_JoystickReport_Input_t* const ReportData);
 void ApplyButtonCommand(Buttons_t button, USB_JoystickReport_Input_t* const ReportData);
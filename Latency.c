@@ -0,0 +1,74 @@
+/*
+Cycle counter and latency statistics
+
+Used by "stats" to show how long input takes from the serial line to the host.
+*/
+
+#include <stdio.h>
+#include "Latency.h"
+
+volatile uint16_t cycles_high = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+	cycles_high++;
+}
+
+void InitCycleCounter(void)
+{
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10); // no prescaling
+	TCNT1 = 0;
+	TIFR1 = (1 << TOV1);
+	TIMSK1 = (1 << TOIE1);
+}
+
+uint32_t GetCycles(void)
+{
+	uint16_t high, low;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		high = cycles_high;
+		low = TCNT1;
+		// the counter has wrapped around but the interrupt hasn't been served yet
+		if ((TIFR1 & (1 << TOV1)) && low < 0x8000)
+			high++;
+	}
+	return ((uint32_t)high << 16) | low;
+}
+
+void AddLatency(Latency_t* const stat, const uint32_t cycles)
+{
+	const uint32_t us = cycles / CYCLES_PER_US;
+
+	if (stat->count == 0 || us < stat->min_us)
+		stat->min_us = us;
+	if (us > stat->max_us)
+		stat->max_us = us;
+
+	// keep the average meaningful instead of wrapping around
+	if (stat->count == UINT16_MAX)
+	{
+		stat->total_us /= 2;
+		stat->count /= 2;
+	}
+	stat->total_us += us;
+	stat->count++;
+}
+
+void ResetLatency(Latency_t* const stat)
+{
+	memset(stat, 0, sizeof(Latency_t));
+}
+
+void PrintLatency(const char* const name, const Latency_t* const stat)
+{
+	if (stat->count == 0)
+	{
+		printf("%s -", name);
+		return;
+	}
+
+	printf("%s %lu/%lu/%lu", name, (unsigned long)stat->min_us,
+		(unsigned long)(stat->total_us / stat->count), (unsigned long)stat->max_us);
+}
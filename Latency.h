@@ -0,0 +1,33 @@
+/** \file
+ *
+ *  Header file for Latency.c.
+ */
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include "Joystick.h"
+
+// Timer1 runs at the CPU clock and its overflows extend it to 32 bits,
+// so GetCycles() wraps around every 268 s at 16 MHz.
+#define CYCLES_PER_US (F_CPU / 1000000UL)
+
+typedef struct {
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t total_us;
+	uint16_t count;
+} Latency_t;
+
+// Start Timer1. Nothing else may use it after this.
+void InitCycleCounter(void);
+// CPU cycles since InitCycleCounter(); safe to call from interrupts.
+uint32_t GetCycles(void);
+
+// Add an interval measured in cycles.
+void AddLatency(Latency_t* const stat, const uint32_t cycles);
+void ResetLatency(Latency_t* const stat);
+// Print "<name> min/avg/max" in microseconds (or "-" with no samples).
+void PrintLatency(const char* const name, const Latency_t* const stat);
+
+#endif
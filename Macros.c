@@ -0,0 +1,241 @@
+/** \file
+ *
+ *  Macros uploaded from PC and stored in EEPROM.
+ *
+ *  An EEPROM byte takes about 3.4 ms to write, and a delete may move the whole pool,
+ *  so the calls below only leave the writes to MacroTask(). It does one whenever
+ *  the EEPROM is ready and doesn't wait for it, so USB reports go on meanwhile.
+ *  The directory is read from its copy in SRAM, which MacroTask() writes back last.
+ */
+
+#include <stdio.h>
+
+#include "Macros.h"
+#include "Protocol.h"
+
+#define MACRO_MAGIC 0x4D
+
+typedef struct {
+	uint16_t offset; // index of the first command in the pool
+	uint8_t count;   // 0 if the slot is empty
+} MacroSlot_t;
+
+EEMEM uint8_t macro_magic;
+EEMEM MacroSlot_t macro_dir[MACRO_SLOTS];
+EEMEM Command macro_pool[MACRO_POOL_SIZE];
+
+MacroSlot_t dir[MACRO_SLOTS];
+
+// Writes left for MacroTask(), in this order
+uint8_t* move_src;      // pool bytes to move down over a deleted macro
+uint8_t* move_dst;
+uint16_t move_left = 0;
+Command append_buffer[FRAME_MAX_PAYLOAD / MACRO_COMMAND_BYTES];
+uint8_t* append_dst;    // commands from a FRAME_MACRO_DATA
+uint8_t append_pos = 0;
+uint8_t append_left = 0;
+bool is_dir_dirty = false;
+uint8_t dir_pos = 0;    // the byte of dir written back next
+
+// Upload in progress
+uint8_t upload_slot;
+uint8_t upload_count = 0;
+uint8_t upload_pos;
+uint16_t upload_offset;
+
+void ReadSlot(const uint8_t slot, MacroSlot_t* const entry)
+{
+	memcpy(entry, &dir[slot], sizeof(MacroSlot_t));
+}
+
+void WriteSlot(const uint8_t slot, const MacroSlot_t* const entry)
+{
+	memcpy(&dir[slot], entry, sizeof(MacroSlot_t));
+	is_dir_dirty = true;
+	dir_pos = 0;
+}
+
+bool IsMacroWriting(void)
+{
+	return move_left > 0 || append_left > 0 || is_dir_dirty;
+}
+
+void MacroTask(void)
+{
+	if (!IsMacroWriting() || !eeprom_is_ready())
+		return;
+
+	if (move_left > 0)
+	{
+		eeprom_update_byte(move_dst++, eeprom_read_byte(move_src++));
+		move_left--;
+	}
+	else if (append_left > 0)
+	{
+		eeprom_update_byte(append_dst++, ((const uint8_t*)append_buffer)[append_pos++]);
+		append_left--;
+	}
+	else
+	{
+		// skip the bytes that haven't changed, which reading doesn't wait for
+		const uint8_t* const src = (const uint8_t*)dir;
+		uint8_t* const dst = (uint8_t*)macro_dir;
+		while (dir_pos < sizeof(dir) && eeprom_read_byte(&dst[dir_pos]) == src[dir_pos])
+			dir_pos++;
+
+		if (dir_pos < sizeof(dir))
+		{
+			eeprom_update_byte(&dst[dir_pos], src[dir_pos]);
+			dir_pos++;
+		}
+		else
+			is_dir_dirty = false;
+	}
+}
+
+// The pool is always packed, so the used part is the sum of every slot
+uint16_t GetPoolUsed(void)
+{
+	MacroSlot_t entry;
+	uint16_t used = 0;
+
+	for (uint8_t i = 0; i < MACRO_SLOTS; i++)
+	{
+		ReadSlot(i, &entry);
+		used += entry.count;
+	}
+
+	return used;
+}
+
+void InitMacros(void)
+{
+	if (eeprom_read_byte(&macro_magic) == MACRO_MAGIC)
+	{
+		eeprom_read_block(dir, macro_dir, sizeof(dir));
+		return;
+	}
+
+	// before USB is up, so this may wait on the EEPROM
+	memset(dir, 0, sizeof(dir));
+	eeprom_update_block(dir, macro_dir, sizeof(dir));
+	eeprom_update_byte(&macro_magic, MACRO_MAGIC);
+}
+
+bool BeginMacro(const uint8_t slot, const uint8_t count)
+{
+	upload_count = 0;
+
+	if (slot >= MACRO_SLOTS || count == 0)
+		return false;
+
+	DeleteMacro(slot);
+
+	uint16_t used = GetPoolUsed();
+	if (used + count > MACRO_POOL_SIZE)
+		return false;
+
+	// write after the used part, and make it visible only on commit
+	upload_slot = slot;
+	upload_count = count;
+	upload_pos = 0;
+	upload_offset = used;
+	return true;
+}
+
+bool AppendMacro(const uint8_t* const data, const uint8_t len)
+{
+	if (upload_count == 0 || len % MACRO_COMMAND_BYTES != 0)
+		return false;
+
+	if (upload_pos + len / MACRO_COMMAND_BYTES > upload_count)
+		return false;
+
+	uint8_t n = 0;
+	append_dst = (uint8_t*)&macro_pool[upload_offset + upload_pos];
+	for (uint8_t i = 0; i < len; i += MACRO_COMMAND_BYTES)
+	{
+		append_buffer[n].button = (Buttons_t)data[i];
+		append_buffer[n].duration = data[i + 1] | (data[i + 2] << 8);
+		n++;
+	}
+	upload_pos += n;
+	append_pos = 0;
+	append_left = n * sizeof(Command);
+
+	return true;
+}
+
+bool CommitMacro(void)
+{
+	if (upload_count == 0 || upload_pos != upload_count)
+		return false;
+
+	const MacroSlot_t entry = { upload_offset, upload_count };
+	WriteSlot(upload_slot, &entry);
+
+	upload_count = 0;
+	return true;
+}
+
+bool DeleteMacro(const uint8_t slot)
+{
+	if (slot >= MACRO_SLOTS)
+		return false;
+
+	MacroSlot_t deleted;
+	ReadSlot(slot, &deleted);
+	if (deleted.count == 0)
+		return false;
+
+	// move the commands behind the deleted ones down
+	uint16_t used = GetPoolUsed();
+	move_src = (uint8_t*)&macro_pool[deleted.offset + deleted.count];
+	move_dst = (uint8_t*)&macro_pool[deleted.offset];
+	move_left = (used - deleted.offset - deleted.count) * sizeof(Command);
+
+	MacroSlot_t entry;
+	for (uint8_t i = 0; i < MACRO_SLOTS; i++)
+	{
+		ReadSlot(i, &entry);
+		if (entry.count > 0 && entry.offset > deleted.offset)
+		{
+			entry.offset -= deleted.count;
+			WriteSlot(i, &entry);
+		}
+	}
+
+	const MacroSlot_t empty = { 0, 0 };
+	WriteSlot(slot, &empty);
+	return true;
+}
+
+uint8_t GetMacroSize(const uint8_t slot)
+{
+	if (slot >= MACRO_SLOTS)
+		return 0;
+
+	MacroSlot_t entry;
+	ReadSlot(slot, &entry);
+	return entry.count;
+}
+
+const Command* GetMacroCommands(const uint8_t slot)
+{
+	MacroSlot_t entry;
+	ReadSlot(slot, &entry);
+	return &macro_pool[entry.offset];
+}
+
+void PrintMacros(void)
+{
+	MacroSlot_t entry;
+	for (uint8_t i = 0; i < MACRO_SLOTS; i++)
+	{
+		ReadSlot(i, &entry);
+		if (entry.count > 0)
+			printf("%u %u\r\n", i, entry.count);
+	}
+
+	printf("free %u\r\n", MACRO_POOL_SIZE - GetPoolUsed());
+}
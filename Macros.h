@@ -0,0 +1,50 @@
+/** \file
+ *
+ *  Header file for Macros.c.
+ */
+
+#ifndef _MACROS_H_
+#define _MACROS_H_
+
+#include "Joystick.h"
+#include "Commands.h"
+
+// Command arrays uploaded from PC and kept in EEPROM, so new loops run without reflashing.
+// Every slot points into a shared pool, which is kept packed by moving later slots on delete.
+#ifndef MACRO_SLOTS
+#define MACRO_SLOTS 8
+#endif
+#define MACRO_POOL_SIZE 160 // commands (3 bytes each)
+
+// Wire format of a command in FRAME_MACRO_DATA: [button] [duration L] [duration H]
+#define MACRO_COMMAND_BYTES 3
+
+// Format the EEPROM if it has never held macros.
+void InitMacros(void);
+
+// Uploading and deleting leave their EEPROM writes to MacroTask(), which takes about
+// 3.4 ms a byte, and SerialTask() holds the next input until IsMacroWriting() is false.
+// return: accepted? (deletes the slot first, and fails if the pool has no room for count)
+bool BeginMacro(const uint8_t slot, const uint8_t count);
+// return: accepted? (data is packed commands following BeginMacro())
+bool AppendMacro(const uint8_t* const data, const uint8_t len);
+// return: all the commands told by BeginMacro() have arrived and the slot is usable now?
+bool CommitMacro(void);
+
+// return: the slot has held a macro?
+bool DeleteMacro(const uint8_t slot);
+
+// Write an EEPROM byte left by the calls above if the EEPROM is ready; call from the main loop.
+void MacroTask(void);
+// return: writes are left? (the pool and the slots may not be read meanwhile)
+bool IsMacroWriting(void);
+
+// The number of commands in the slot (0 if empty)
+uint8_t GetMacroSize(const uint8_t slot);
+// Commands in the EEPROM address space (read them with eeprom_read_block())
+const Command* GetMacroCommands(const uint8_t slot);
+
+// Print "<slot> <size>" of every used slot and the free pool size.
+void PrintMacros(void);
+
+#endif
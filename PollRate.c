@@ -0,0 +1,116 @@
+/*
+Report rate profiles
+
+The configuration descriptor of every profile lives in flash (see Descriptors.c),
+and CALLBACK_USB_GetDescriptor() hands out the active one.
+*/
+
+#include <stdio.h>
+#include "PollRate.h"
+
+typedef struct {
+	uint8_t interval_ms;
+} PollProfile_t;
+
+#define POLL_PROFILE(ms) \
+	{ (ms) }
+const PollProfile_t poll_profiles[POLL_RATES] PROGMEM = {
+	[POLL_RATE_1MS] = POLL_PROFILE(1),
+	[POLL_RATE_4MS] = POLL_PROFILE(4),
+	[POLL_RATE_5MS] = POLL_PROFILE(5),
+	[POLL_RATE_8MS] = POLL_PROFILE(8),
+};
+
+#if POLL_MS == 1
+#define DEFAULT_POLL_RATE POLL_RATE_1MS
+#elif POLL_MS == 4
+#define DEFAULT_POLL_RATE POLL_RATE_4MS
+#elif POLL_MS == 5
+#define DEFAULT_POLL_RATE POLL_RATE_5MS
+#elif POLL_MS == 8
+#define DEFAULT_POLL_RATE POLL_RATE_8MS
+#else
+#error POLL_MS must be 1, 4, 5 or 8
+#endif
+
+// The interval in ms; erased EEPROM (0xFF) or anything without a profile means the default
+EEMEM uint8_t poll_rate_setting;
+
+uint8_t poll_rate = DEFAULT_POLL_RATE;
+uint8_t poll_interval_ms;
+// The ms of units the polls handed out so far have fallen short of (less than poll_interval_ms)
+uint8_t unit_carry_ms = 0;
+
+// Reports taken by the host since poll_count_start_ms
+uint16_t taken_report_count = 0;
+uint16_t poll_count_start_ms = 0;
+
+static bool FindPollRate(const uint8_t interval_ms, uint8_t* const rate)
+{
+	for (uint8_t i = 0; i < POLL_RATES; i++)
+	{
+		if (pgm_read_byte(&poll_profiles[i].interval_ms) == interval_ms)
+		{
+			*rate = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void ApplyPollRate(const uint8_t rate)
+{
+	poll_rate = rate;
+	poll_interval_ms = pgm_read_byte(&poll_profiles[rate].interval_ms);
+	unit_carry_ms = 0;
+}
+
+void InitPollRate(void)
+{
+	uint8_t rate;
+	if (!FindPollRate(eeprom_read_byte(&poll_rate_setting), &rate))
+		rate = DEFAULT_POLL_RATE;
+	ApplyPollRate(rate);
+}
+
+uint8_t GetPollIntervalMS(void)
+{
+	return poll_interval_ms;
+}
+
+uint32_t PollsOfUnits(const uint16_t units)
+{
+	const uint32_t nominal_ms = (uint32_t)units * COMMAND_UNIT_NOMINAL_MS + unit_carry_ms;
+	unit_carry_ms = nominal_ms % poll_interval_ms;
+	return nominal_ms / poll_interval_ms;
+}
+
+bool SetPollRate(const uint8_t interval_ms)
+{
+	uint8_t rate;
+	if (!FindPollRate(interval_ms, &rate))
+		return false;
+
+	eeprom_update_byte(&poll_rate_setting, interval_ms);
+	ApplyPollRate(rate);
+	return true;
+}
+
+void CountTakenReport(void)
+{
+	if (taken_report_count < UINT16_MAX)
+		taken_report_count++;
+}
+
+void PrintPollRate(void)
+{
+	printf("rate %u polls %u ms %u\r\n", GetPollIntervalMS(), taken_report_count,
+		(uint16_t)(GetMillis() - poll_count_start_ms));
+	ResetPollCount();
+}
+
+void ResetPollCount(void)
+{
+	taken_report_count = 0;
+	poll_count_start_ms = GetMillis();
+}
@@ -0,0 +1,52 @@
+/** \file
+ *
+ *  Header file for PollRate.c.
+ */
+
+#ifndef _POLL_RATE_H_
+#define _POLL_RATE_H_
+
+#include "Joystick.h"
+
+// Report rate profiles: the polling interval the endpoint descriptors ask the host for.
+// The build picks the default with "make POLL_MS=<ms>"; "rate <ms>" keeps another one
+// in EEPROM and enumerates again with it.
+typedef enum {
+	POLL_RATE_1MS,
+	POLL_RATE_4MS,
+	POLL_RATE_5MS,
+	POLL_RATE_8MS,
+	POLL_RATES
+} PollRate_t;
+
+#ifndef POLL_MS
+#define POLL_MS 5
+#endif
+
+// Table durations count units of COMMAND_UNIT_NOMINAL_MS of polls at the rate asked for,
+// which is what echo_ratio = 3 gave at 5 ms (a host polling slower stretches them, as before).
+#define COMMAND_UNIT_NOMINAL_MS 15
+
+// The active profile, fixed from one enumeration to the next
+extern uint8_t poll_rate;
+
+// Load the profile kept in EEPROM (the build default if there's none). Call before USB_Init().
+void InitPollRate(void);
+uint8_t GetPollIntervalMS(void);
+// Polls a step of units lasts with the active profile.
+// A unit isn't always a whole number of polls (3.75 at 4 ms), so the time a step falls short of
+// is carried to the next one, and a looping table keeps within a poll of its nominal time.
+uint32_t PollsOfUnits(const uint16_t units);
+// Keep the profile with the interval in EEPROM and make it active.
+// The host only sees it after enumerating again.
+// return: there is a profile for interval_ms?
+bool SetPollRate(const uint8_t interval_ms);
+
+// Measure the interval the host really polls at, from IN reports it has taken
+void CountTakenReport(void);
+// Print "rate <ms> polls <n> ms <ms>": the profile, and the reports taken in the time since
+// the last call (or the last enumeration), then start over.
+void PrintPollRate(void);
+void ResetPollCount(void);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+Cycle profiling of the hot paths
+
+Only built with "make PROFILE=1". Samples are kept in cycles of the 16 MHz
+clock, so they show how much of the 1 ms between SOFs every section takes.
+*/
+
+#include <stdio.h>
+#include "Profile.h"
+
+#ifdef PROFILE
+
+typedef struct {
+	uint32_t min;
+	uint32_t max;
+	uint32_t total;
+	uint16_t count;
+} ProfileStat_t;
+
+ProfileStat_t profile_stats[PROFILE_POINTS];
+uint16_t missed_poll_count = 0;
+
+const char* const profile_names[PROFILE_POINTS] = {
+	"rx_isr",
+	"parse_line",
+	"parse_frame",
+	"get_next_report",
+	"endpoint_write",
+	"main_loop",
+};
+
+// also called from the RX interrupt, but every point has a single caller
+void AddProfile(const ProfilePoint_t point, const uint32_t cycles)
+{
+	ProfileStat_t* const stat = &profile_stats[point];
+
+	if (stat->count == 0 || cycles < stat->min)
+		stat->min = cycles;
+	if (cycles > stat->max)
+		stat->max = cycles;
+
+	// keep the average meaningful instead of wrapping around
+	if (stat->count == UINT16_MAX || stat->total > UINT32_MAX - cycles)
+	{
+		stat->total /= 2;
+		stat->count /= 2;
+	}
+	stat->total += cycles;
+	stat->count++;
+}
+
+void CountMissedPolls(void)
+{
+	// the controller NAKed an IN token since the last check
+	if (UEINTX & (1 << NAKINI))
+	{
+		// writing 1 leaves the other flags alone
+		UEINTX = (uint8_t)~(1 << NAKINI);
+		missed_poll_count++;
+	}
+}
+
+void PrintProfile(void)
+{
+	for (uint8_t i = 0; i < PROFILE_POINTS; i++)
+	{
+		ProfileStat_t stat;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			memcpy(&stat, &profile_stats[i], sizeof(ProfileStat_t));
+		}
+
+		// min/avg/max in cycles
+		if (stat.count == 0)
+			printf("%s -\r\n", profile_names[i]);
+		else
+			printf("%s %lu/%lu/%lu n %u\r\n", profile_names[i], (unsigned long)stat.min,
+				(unsigned long)(stat.total / stat.count), (unsigned long)stat.max, stat.count);
+	}
+	printf("missed_polls %u\r\n", missed_poll_count);
+}
+
+void ResetProfile(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memset(profile_stats, 0, sizeof(profile_stats));
+	}
+	missed_poll_count = 0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/** \file
+ *
+ *  Header file for Profile.c.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "Joystick.h"
+#include "Latency.h"
+
+// Cycle profiling, built only with "make PROFILE=1" and shown by "profile".
+// Every section is timed on the Timer1 cycle counter (see Latency.h),
+// which adds about 60 cycles of its own to each sample.
+typedef enum {
+	PROFILE_RX_ISR,          // USART1_RX_vect, without the prologue and epilogue
+	PROFILE_PARSE_LINE,      // ParseLine()
+	PROFILE_PARSE_FRAME,     // ParseFrame(), EEPROM writes of macro frames included
+	PROFILE_GET_NEXT_REPORT, // GetNextReport()
+	PROFILE_ENDPOINT_WRITE,  // writing the IN report and clearing the bank
+	PROFILE_MAIN_LOOP,       // one pass of the main loop
+	PROFILE_POINTS
+} ProfilePoint_t;
+
+#ifdef PROFILE
+#define PROFILE_BEGIN(start) const uint32_t start = GetCycles()
+#define PROFILE_END(point, start) AddProfile(point, GetCycles() - (start))
+#else
+#define PROFILE_BEGIN(start)
+#define PROFILE_END(point, start)
+#endif
+
+void AddProfile(const ProfilePoint_t point, const uint32_t cycles);
+// Count IN polls the host found the bank empty for. The IN endpoint must be selected.
+void CountMissedPolls(void);
+void PrintProfile(void);
+void ResetProfile(void);
+
+#endif
@@ -0,0 +1,85 @@
+/** \file
+ *
+ *  Binary serial protocol shared with SerialController/Commands/Protocol.py.
+ */
+
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+// Frame layout
+// [SYNC] [LEN] [TYPE] [PAYLOAD (LEN bytes)] [SUM]
+// SUM is the low byte of LEN + TYPE + every payload byte.
+// Frames are only accepted after the "binary" handshake and only at the start of a line,
+// so the text commands keep working in either mode.
+#define FRAME_SYNC        0xF5
+#define FRAME_MAX_PAYLOAD 16
+
+typedef enum {
+	// Replace the whole PC report
+	// payload: [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY]
+	FRAME_REPORT = 0x01,
+	// Append a report to the input queue, held for the given number of polls
+	// payload: [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY] [polls L] [polls H]
+	FRAME_QUEUE = 0x02,
+	// Start uploading a macro to EEPROM, replacing the slot
+	// payload: [slot] [number of commands]
+	FRAME_MACRO_BEGIN = 0x03,
+	// Commands of the macro being uploaded, up to 5 at a time
+	// payload: ([button] [duration L] [duration H]) * n
+	FRAME_MACRO_DATA = 0x04,
+	// Finish uploading; the slot can be played by "macro play <slot>" from now on
+	// payload: none
+	FRAME_MACRO_COMMIT = 0x05,
+	// Change a part of the PC report in place, leaving the rest as it is
+	// payload: a sequence of DeltaOp_t, each followed by its arguments
+	FRAME_DELTA = 0x06,
+	// Queue a loop: the next span queued reports are played count times
+	// payload: [count L] [count H] [span]
+	FRAME_QUEUE_REPEAT = 0x07,
+} FrameType_t;
+
+// Frames sent by the MCU ("output on", ACK mode only), in the same layout.
+// They can come between any two replies; the PC tells them apart by FRAME_SYNC.
+typedef enum {
+	// The host has sent an OUT report unlike the last one forwarded (rumble, LEDs)
+	// payload: [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY]
+	FRAME_OUTPUT_REPORT = 0x81,
+} McuFrameType_t;
+
+typedef enum {
+	DELTA_BUTTONS_SET   = 0x01, // [mask L] [mask H] pressed
+	DELTA_BUTTONS_CLEAR = 0x02, // [mask L] [mask H] released
+	DELTA_HAT           = 0x03, // [HAT]
+	DELTA_STICK_L       = 0x04, // [LX] [LY]
+	DELTA_STICK_R       = 0x05, // [RX] [RY]
+} DeltaOp_t;
+
+// One-byte replies to handshakes ("binary", "baud")
+#define PROTO_ACK 0x06
+#define PROTO_NAK 0x15
+
+// One-byte replies in the ACK mode ("ack on")
+// Every line and frame is answered with ACK or NAK ORed with a 5-bit sequence number,
+// which starts from 0 with the reply to "ack on" itself. A skipped number means a lost reply,
+// while input lost on the way in shows up as fewer replies than lines and frames sent.
+// Characters are no longer echoed by default ("echo on" brings it back).
+#define PROTO_SEQ_ACK  0x80
+#define PROTO_SEQ_NAK  0xA0
+#define PROTO_SEQ_MASK 0x1F
+
+// Credits ("credit on", ACK mode only)
+// Every ACK/NAK is followed by PROTO_CREDIT ORed with the free slots of the input queue,
+// counted after the line or frame it answers. The same byte is also sent on its own
+// whenever playing frees slots, so the PC can keep the queue full without overflowing it:
+// its credits are the last count minus the queued frames still waiting for replies.
+#define PROTO_CREDIT      0xC0
+#define PROTO_CREDIT_MASK 0x0F
+
+// Baud rate at power-on. The host opens the port at this rate and may
+// switch both sides to a faster one with "baud <rate>", which is acknowledged
+// at the old rate before the MCU switches.
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 9600
+#endif
+
+#endif
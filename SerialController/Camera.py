@@ -4,16 +4,28 @@
 import sys, os
 import cv2
 import time, datetime
+import threading
 
+# A grabber thread reads the device all the time and keeps only the newest frame,
+# so readers never block on the device or get a stale buffered frame
 class Camera:
 	def __init__(self):
 		self.camera = None
 		self.capture_size = (1280, 720)
 		self.capture_dir = "Captures"
 
+		# the newest frame and when it was read (time.perf_counter()), numbered from 1
+		self.image_bgr = None
+		self.frame_time = 0
+		self.frame_number = 0
+		self.frame_cond = threading.Condition()
+		self.grabber = None
+		self.is_grabbing = False
+
 	def openCamera(self, cameraId):
-		if self.camera is not None and self.camera.isOpened():
-			self.destroy()
+		# the grabber of the device opened before must be gone before the next one starts,
+		# even if that device has stopped working
+		self.destroy()
 
 		if os.name == 'nt':
 			self.camera = cv2.VideoCapture(cameraId, cv2.CAP_DSHOW)
@@ -28,13 +40,55 @@ class Camera:
 		self.camera.set(cv2.CAP_PROP_FRAME_WIDTH, self.capture_size[0])
 		self.camera.set(cv2.CAP_PROP_FRAME_HEIGHT, self.capture_size[1])
 
+		self.is_grabbing = True
+		self.grabber = threading.Thread(target=self.grab, args=(self.camera,), daemon=True)
+		self.grabber.start()
+
 	def isOpened(self):
-		return self.camera.isOpened()
+		return self.camera is not None and self.camera.isOpened()
+
+	# camera: the device this grabber was started for, which only it reads
+	def grab(self, camera):
+		while self.is_grabbing:
+			ret, frame = camera.read()
+			if not ret:
+				time.sleep(0.01)
+				continue
+
+			with self.frame_cond:
+				self.image_bgr = frame
+				self.frame_time = time.perf_counter()
+				self.frame_number += 1
+				self.frame_cond.notify_all()
 
+	# Forget the frame of the device opened before, so it isn't served as a new one
+	def clearFrame(self):
+		with self.frame_cond:
+			self.image_bgr = None
+			self.frame_time = 0
+			self.frame_number = 0
+
+	# The newest frame without waiting
+	# It's shared with other readers, so copy it before drawing on it
+	# Before the first frame this blocks for up to a second, so the GUI uses readFrameInfo() instead.
 	def readFrame(self):
-		_, self.image_bgr = self.camera.read()
+		# only the first frame is waited for
+		if self.frame_number == 0 and self.is_grabbing:
+			return self.waitNewFrame(0)[0]
 		return self.image_bgr
 
+	# return: (frame, capture time, frame number) of the newest frame
+	def readFrameInfo(self):
+		with self.frame_cond:
+			return self.image_bgr, self.frame_time, self.frame_number
+
+	# Wait for a frame newer than the frame number given
+	# return: (frame, capture time, frame number), or the newest one on timeout
+	def waitNewFrame(self, last_number, timeout=1.0):
+		with self.frame_cond:
+			self.frame_cond.wait_for(lambda: self.frame_number > last_number or not self.is_grabbing, timeout)
+			return self.image_bgr, self.frame_time, self.frame_number
+
 	def saveCapture(self):
 		dt_now = datetime.datetime.now()
 		fileName = dt_now.strftime('%Y-%m-%d_%H-%M-%S')+".png"
@@ -47,6 +101,15 @@ class Camera:
 		print('capture succeeded: ' + save_path)
 	
 	def destroy(self):
-		if self.camera is not None and self.camera.isOpened():
-			self.camera.release()
+		if self.grabber is not None:
+			with self.frame_cond:
+				self.is_grabbing = False
+				self.frame_cond.notify_all()
+			self.grabber.join()
+			self.grabber = None
+		self.clearFrame()
+
+		if self.camera is not None:
+			if self.camera.isOpened():
+				self.camera.release()
 			self.camera = None
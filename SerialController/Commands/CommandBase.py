@@ -10,6 +10,7 @@ class Command:
 	def __init__(self):
 		self.isRunning = False
 
+	# return: the command has started?
 	@abstractclassmethod
 	def start(self, ser, postProcess=None):
 		pass
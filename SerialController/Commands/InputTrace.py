@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Binary traces of the reports a session sends (Sender.startRecording()), for replaying
+# the session and as fixtures for the host simulation (sim/Sim.c reads them too)
+#
+# [header] [record]*, little endian
+# header: "PCIT" [version] [record size] [reserved (2)] [poll interval in us (4)]
+# record: [time in ns from the start (8)] [Button (2)] [HAT] [LX] [LY] [RX] [RY] [polls (2)]
+#   polls is 0 for a report sent at once, or the USB polls a queued one is held for
+
+import collections
+import mmap
+import struct
+import threading
+import time
+from . import Protocol
+
+MAGIC = b'PCIT'
+VERSION = 1
+HEADER = struct.Struct('<4sBBHI')
+RECORD = struct.Struct('<QHBBBBBH')
+
+# polls a single queued entry can hold a report for
+MAX_QUEUE_POLLS = 0xFFFF
+
+Record = collections.namedtuple('Record', 'time button hat lx ly rx ry polls')
+
+class TraceWriter:
+	def __init__(self, path, poll_interval):
+		self.file = open(path, 'wb')
+		self.file.write(HEADER.pack(MAGIC, VERSION, RECORD.size, 0, int(poll_interval * 1000000)))
+		self.start = time.perf_counter_ns()
+		self.count = 0
+		# the GUI and the command thread may both send
+		self.lock = threading.Lock()
+
+	def add(self, report, polls=None):
+		btn, hat, lx, ly, rx, ry = report
+		with self.lock:
+			self.file.write(RECORD.pack(time.perf_counter_ns() - self.start,
+				btn, hat, lx, ly, rx, ry, 0 if polls is None else min(polls, MAX_QUEUE_POLLS)))
+			self.count += 1
+
+	def close(self):
+		with self.lock:
+			self.file.close()
+
+# Reads the records straight from the mapped file, so a long session isn't loaded at once
+class TraceReader:
+	def __init__(self, path):
+		self.file = open(path, 'rb')
+		self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+
+		magic, version, self.record_size, _, interval_us = HEADER.unpack_from(self.map, 0)
+		if magic != MAGIC or version != VERSION or self.record_size < RECORD.size:
+			self.close()
+			raise ValueError(path + ' is not an input trace')
+		# seconds between polls when it was recorded
+		self.poll_interval = interval_us / 1000000
+
+	def __len__(self):
+		return (len(self.map) - HEADER.size) // self.record_size
+
+	def __getitem__(self, i):
+		if not 0 <= i < len(self):
+			raise IndexError('record ' + str(i) + ' is out of the trace')
+		return Record._make(RECORD.unpack_from(self.map, HEADER.size + i * self.record_size))
+
+	def __iter__(self):
+		for i in range(len(self)):
+			yield self[i]
+
+	def close(self):
+		self.map.close()
+		self.file.close()
+
+# Play a trace back through the MCU's input queue, so the MCU times every report itself:
+# queued ones for the polls they were recorded with, reports sent at once until the next record,
+# counted in polls of ser.poll_interval. Needs the credits to keep the queue fed.
+# return: the number of queue entries sent
+def replay(ser, path, is_stopped=None):
+	if not ser.is_binary or ser.credits is None:
+		print('replaying a trace needs the binary mode and credits from the MCU')
+		return 0
+
+	reader = TraceReader(path)
+	sent = 0
+	try:
+		for i in range(len(reader)):
+			if is_stopped is not None and is_stopped():
+				break
+
+			record = reader[i]
+			if record.polls > 0:
+				polls = record.polls
+			elif i + 1 < len(reader):
+				polls = round((reader[i + 1].time - record.time) / 1e9 / ser.poll_interval)
+			else:
+				polls = 1
+			# replaced before the console took it
+			if polls == 0:
+				continue
+
+			payload = struct.pack('<HBBBBB', record.button, record.hat, record.lx, record.ly, record.rx, record.ry)
+			while polls > 0:
+				held = min(polls, MAX_QUEUE_POLLS)
+				ser.writeFrame(Protocol.frame(Protocol.FRAME_QUEUE, payload + struct.pack('<H', held)))
+				polls -= held
+				sent += 1
+		ser.waitForReplies()
+	finally:
+		reader.close()
+	return sent
@@ -1,9 +1,10 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 
-import math
+import math, struct
 from collections import OrderedDict
 from enum import IntFlag, IntEnum, Enum, auto
+from . import Protocol
 
 class Button(IntFlag):
 	Y = auto()
@@ -51,6 +52,13 @@ min = 0
 center = 128
 max = 255
 
+# seconds between USB polls of the MCU by the console, used to turn seconds into queued polls
+# until Sender.measurePollInterval() has measured them
+POLL_INTERVAL = 0.008
+
+# (btn, hat, lx, ly, rx, ry) the MCU goes back to on 'end'
+NEUTRAL_REPORT = (0, int(Hat.CENTER), center, center, center, center)
+
 # serial format
 class SendFormat:
 	def __init__(self):
@@ -67,6 +75,9 @@ class SendFormat:
 		self.L_stick_changed = False
 		self.R_stick_changed = False
 
+		# the report the MCU holds as its PC report (None if unknown)
+		self.sent = None
+
 	def setButton(self, btns):
 		for btn in btns:
 			self.format['btn'] |= btn
@@ -160,6 +171,55 @@ class SendFormat:
 
 		return str_format # the last space is not needed
 
+	# binary version of convert2str (whole report is sent every time)
+	# If polls is given, the report is queued on the MCU and held for that many USB polls
+	def convert2frame(self, polls=None):
+		payload = struct.pack('<HBBBBB', int(self.format['btn']), int(self.format['hat']),
+			self.format['lx'], self.format['ly'], self.format['rx'], self.format['ry'])
+
+		self.L_stick_changed = False
+		self.R_stick_changed = False
+
+		if polls is None:
+			self.sent = self.getReport()
+			return Protocol.frame(Protocol.FRAME_REPORT, payload)
+		else:
+			return Protocol.frame(Protocol.FRAME_QUEUE, payload + struct.pack('<H', int(polls)))
+
+	def getReport(self):
+		return (int(self.format['btn']), int(self.format['hat']),
+			self.format['lx'], self.format['ly'], self.format['rx'], self.format['ry'])
+
+	# binary version that carries only what has changed since the last report sent
+	# The whole report is sent when the MCU's one is unknown.
+	def convert2delta(self):
+		if self.sent is None:
+			return self.convert2frame()
+
+		btn, hat, lx, ly, rx, ry = self.getReport()
+		sent_btn, sent_hat, sent_lx, sent_ly, sent_rx, sent_ry = self.sent
+		ops = b''
+
+		if btn & ~sent_btn:
+			ops += struct.pack('<BH', Protocol.DELTA_BUTTONS_SET, btn & ~sent_btn)
+		if sent_btn & ~btn:
+			ops += struct.pack('<BH', Protocol.DELTA_BUTTONS_CLEAR, sent_btn & ~btn)
+		if hat != sent_hat:
+			ops += bytes([Protocol.DELTA_HAT, hat])
+		if (lx, ly) != (sent_lx, sent_ly):
+			ops += bytes([Protocol.DELTA_STICK_L, lx, ly])
+		if (rx, ry) != (sent_rx, sent_ry):
+			ops += bytes([Protocol.DELTA_STICK_R, rx, ry])
+
+		self.L_stick_changed = False
+		self.R_stick_changed = False
+		self.sent = (btn, hat, lx, ly, rx, ry)
+
+		return Protocol.frame(Protocol.FRAME_DELTA, ops)
+
+	def resetSent(self):
+		self.sent = None
+
 # This class handle L stick and R stick at any angles
 class Direction:
 	def __init__(self, stick, angle, isDegree=True, showName=None):
@@ -237,8 +297,18 @@ class KeyPress:
 		self.ser = ser
 		self.format = SendFormat()
 		self.holdButton = []
+		self.errors = 0
+
+		# inputs queued so far and their playing time (see takeQueued())
+		self.queued_entries = 0
+		self.queued_polls = 0
+		self.repeat_count = 0
+		self.repeat_left = 0
+		self.repeat_polls = 0
+		self.repeat_records = None	# reports of the loop being queued, recorded once it's complete
 	
-	def input(self, btns):
+	# polls: queue the input on the MCU and hold it for the numbers of USB polls
+	def input(self, btns, polls=None):
 		if not isinstance(btns, list):
 			btns = [btns]
 		
@@ -252,9 +322,9 @@ class KeyPress:
 		self.format.setButton([btn for btn in btns if type(btn) is Button])
 		self.format.setHat([btn for btn in btns if type(btn) is Hat])
 		self.format.setAnyDirection([btn for btn in btns if type(btn) is Direction])
-		self.ser.writeRow(self.format.convert2str())
+		self.send(polls)
 
-	def inputEnd(self, btns):
+	def inputEnd(self, btns, polls=None):
 		if not isinstance(btns, list):
 			btns = [btns]
 
@@ -269,9 +339,81 @@ class KeyPress:
 		self.format.unsetHat()
 		self.format.unsetDirection(tilts)
 
-		self.ser.writeRow(self.format.convert2str())
-
-	def hold(self, btns):
+		self.send(polls)
+
+	# send current format in the mode Sender is working in
+	def send(self, polls=None):
+		# a rejected or lost frame leaves the MCU's report unknown
+		errors = self.ser.nak_count + self.ser.lost_count
+		if errors != self.errors:
+			self.errors = errors
+			self.format.resetSent()
+
+		if polls is not None:
+			self.countQueuedPolls(polls)
+
+		if self.ser.is_binary and polls is None:
+			self.ser.writeFrame(self.format.convert2delta())
+		elif self.ser.is_binary:
+			self.ser.writeFrame(self.format.convert2frame(polls))
+		elif polls is None:
+			self.ser.writeRow(self.format.convert2str())
+		else:
+			raise RuntimeError('queued inputs need the binary mode of the MCU')
+		self.record(polls)
+
+	# Loops queued by repeat() are recorded unrolled, as the MCU plays them
+	def record(self, polls):
+		report = self.format.getReport()
+		if polls is None or self.repeat_records is None:
+			self.ser.recordReport(report, polls)
+			return
+
+		self.repeat_records.append((report, polls))
+		if self.repeat_left == 0:
+			for _ in range(self.repeat_count):
+				for report, polls in self.repeat_records:
+					self.ser.recordReport(report, polls)
+			self.repeat_records = None
+
+	# queue a loop on the MCU: the next 'span' queued inputs are played 'count' times
+	# (the MCU plays a count of 0 once, so it isn't sent)
+	def repeat(self, count, span):
+		if not self.ser.is_binary:
+			raise RuntimeError('queued inputs need the binary mode of the MCU')
+		if not 0 < count <= 0xFFFF:
+			raise ValueError('a queued loop is played 1 to 65535 times')
+		if not 0 < span < Protocol.INPUT_QUEUE_SIZE:
+			raise ValueError('a queued loop needs 1 to ' + str(Protocol.INPUT_QUEUE_SIZE - 1) + ' inputs')
+
+		self.ser.writeFrame(Protocol.frame(Protocol.FRAME_QUEUE_REPEAT, struct.pack('<HB', count, span)))
+		self.queued_entries += 1
+		self.repeat_count = count
+		self.repeat_left = span
+		self.repeat_polls = 0
+		self.repeat_records = []
+
+	def countQueuedPolls(self, polls):
+		self.queued_entries += 1
+		# the MCU holds every input at least for a poll
+		polls = polls if polls > 0 else 1
+		if self.repeat_left == 0:
+			self.queued_polls += polls
+			return
+
+		self.repeat_polls += polls
+		self.repeat_left -= 1
+		if self.repeat_left == 0:
+			self.queued_polls += self.repeat_polls * self.repeat_count
+
+	# return: (queue entries, USB polls to play them) of the inputs queued since the last call
+	def takeQueued(self):
+		queued = (self.queued_entries, self.queued_polls)
+		self.queued_entries = 0
+		self.queued_polls = 0
+		return queued
+
+	def hold(self, btns, polls=None):
 		if not isinstance(btns, list):
 			btns = [btns]
 
@@ -282,16 +424,18 @@ class KeyPress:
 			
 			self.holdButton.append(btn)
 		
-		self.input(btns)
+		self.input(btns, polls)
 		
-	def holdEnd(self, btns):
+	def holdEnd(self, btns, polls=None):
 		if not isinstance(btns, list):
 			btns = [btns]
 		
 		for btn in btns:
 			self.holdButton.remove(btn)
 
-		self.inputEnd(btns)
+		self.inputEnd(btns, polls)
 	
 	def end(self):
-		self.ser.writeRow('end')
\ No newline at end of file
+		self.ser.writeRow('end')
+		self.ser.recordReport(NEUTRAL_REPORT)
+		self.format.resetSent()
\ No newline at end of file
@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Compiles PythonCommands that are fixed press/wait sequences into MCU macros
+# do() runs against a fake Sender on a virtual clock, and every report it would have sent
+# becomes a command timed in milliseconds on the MCU's own clock (see MS() in Commands.h).
+# The result can be uploaded to an EEPROM slot (see McuCommand) or pasted into Commands.c.
+
+import contextlib
+import io
+from .Keys import KeyPress, Button, Hat, POLL_INTERVAL
+from .McuCommandBase import McuButton, ms, press, stickL, stickR
+from .PythonCommandBase import StopThread
+from . import Protocol
+
+# longest duration of a single command (the 15 bits of MS())
+MAX_COMMAND_MS = 0x7FFF
+# passes of the loop after the head of a command that never ends (the most OP_REPEAT counts)
+MAX_REPEAT = 0xFFFF
+# reports shorter than this are dropped (several rows written at once)
+MIN_REPORT_MS = 1
+
+NEUTRAL = (0, int(Hat.CENTER), 128, 128, 128, 128)
+
+# reports a single Buttons_t value makes (see button_reports[] in Joystick.c)
+BUTTON_REPORTS = {
+	(0, int(Hat.CENTER), 128, 0, 128, 128): McuButton.UP,
+	(0, int(Hat.CENTER), 128, 255, 128, 128): McuButton.DOWN,
+	(0, int(Hat.CENTER), 0, 128, 128, 128): McuButton.LEFT,
+	(0, int(Hat.CENTER), 255, 128, 128, 128): McuButton.RIGHT,
+	(0, int(Hat.CENTER), 0, 0, 128, 128): McuButton.UPLEFT,
+	(0, int(Hat.CENTER), 255, 0, 128, 128): McuButton.UPRIGHT,
+	(0, int(Hat.CENTER), 0, 255, 128, 128): McuButton.DOWNLEFT,
+	(0, int(Hat.CENTER), 255, 255, 128, 128): McuButton.DOWNRIGHT,
+	(int(Button.X), int(Hat.CENTER), 128, 128, 128, 128): McuButton.X,
+	(int(Button.Y), int(Hat.CENTER), 128, 128, 128, 128): McuButton.Y,
+	(int(Button.A), int(Hat.CENTER), 128, 128, 128, 128): McuButton.A,
+	(int(Button.B), int(Hat.CENTER), 128, 128, 128, 128): McuButton.B,
+	(int(Button.L), int(Hat.CENTER), 128, 128, 128, 128): McuButton.L,
+	(int(Button.R), int(Hat.CENTER), 128, 128, 128, 128): McuButton.R,
+	(int(Button.PLUS), int(Hat.CENTER), 128, 128, 128, 128): McuButton.PLUS,
+	(int(Button.MINUS), int(Hat.CENTER), 128, 128, 128, 128): McuButton.MINUS,
+	(int(Button.L | Button.R), int(Hat.CENTER), 128, 128, 128, 128): McuButton.TRIGGERS,
+	(int(Button.HOME), int(Hat.CENTER), 128, 128, 128, 128): McuButton.HOME,
+	NEUTRAL: McuButton.NOP,
+}
+
+# The command did something a fixed sequence can't (the camera, reading the MCU, ...)
+class NotCompilable(Exception):
+	pass
+
+# Ends the dry run of a command that never finishes by itself
+class TraceLimit(Exception):
+	pass
+
+class VirtualScheduler:
+	def __init__(self, limit):
+		self.now = 0.0
+		self.limit = limit
+
+	def start(self):
+		pass
+
+	def stop(self):
+		pass
+
+	def wait(self, seconds, is_hold=False):
+		self.now += seconds
+		if self.now >= self.limit:
+			raise TraceLimit()
+
+	def resync(self):
+		pass
+
+	def printStats(self):
+		pass
+
+# Takes the place of Sender in the text mode and keeps the reports with the time they were sent
+class TraceSender:
+	def __init__(self, scheduler):
+		self.scheduler = scheduler
+		self.is_binary = False
+		self.is_ack = False
+		self.is_output = False
+		self.nak_count = 0
+		self.lost_count = 0
+		self.credits = None
+		self.poll_interval = POLL_INTERVAL
+		self.report = NEUTRAL
+		self.changes = [(0.0, NEUTRAL)]	# (time, report)
+
+	def writeRow(self, row):
+		words = row.split()
+		if words == ['end']:
+			self.setReport(NEUTRAL)
+			return
+		if not words or not all(c in '0123456789abcdefABCDEF' for c in ''.join(words)):
+			raise NotCompilable('the command sends "' + row + '" to the MCU')
+
+		# "<buttons << 2 | L | R> <hat> [lx ly] [rx ry]" (see SendFormat.convert2str())
+		values = [int(w, 16) for w in words]
+		flags = values[0]
+		btn, hat = flags >> 2, values[1]
+		lx, ly, rx, ry = self.report[2:]
+		rest = values[2:]
+		if flags & 0x2:
+			lx, ly, rest = rest[0], rest[1], rest[2:]
+		if flags & 0x1:
+			rx, ry = rest[0], rest[1]
+		self.setReport((btn, hat, lx, ly, rx, ry))
+
+	def setReport(self, report):
+		self.report = report
+		now = self.scheduler.now
+		# rows written at the same moment leave only the last report
+		if self.changes[-1][0] == now:
+			self.changes.pop()
+		if not self.changes or self.changes[-1][1] != report:
+			self.changes.append((now, report))
+
+	def writeFrame(self, frame, reply_timeout=None):
+		raise NotCompilable('the command queues frames on the MCU')
+
+	def beginBatch(self):
+		pass
+
+	def endBatch(self):
+		pass
+
+	def waitForReplies(self):
+		pass
+
+	def enableOutputReports(self):
+		raise NotCompilable('the command waits for OUT reports')
+
+	def disableOutputReports(self):
+		pass
+
+	def recordReport(self, report, polls=None):
+		pass
+
+	def resetLatency(self):
+		pass
+
+	def printLatency(self):
+		pass
+
+# Run do() of the command without a controller or a camera until it finishes or
+# reaches 'limit' seconds
+# return: ([(report, seconds)] of every report it has sent, the trace was cut at the limit?)
+def trace(command, limit=600):
+	scheduler = VirtualScheduler(limit)
+	ser = TraceSender(scheduler)
+	command.scheduler = scheduler
+	command.keys = KeyPress(ser)
+	command.alive = True
+
+	# KeyPress logs every input
+	is_cut = False
+	with contextlib.redirect_stdout(io.StringIO()):
+		try:
+			command.do()
+			command.finish()
+		except StopThread:
+			pass
+		except TraceLimit:
+			is_cut = True
+		except NotCompilable:
+			raise
+		except AttributeError as e:
+			# ImageProcPythonCommand runs without a camera here
+			raise NotCompilable('the command needs more than inputs at ' +
+				'{:.2f}'.format(scheduler.now) + ' s (' + str(e) + ')')
+
+	changes = ser.changes + [(scheduler.now, None)]
+	# the virtual clock sums up floats
+	return [(report, round(end - start, 4)) for (start, report), (end, _) in zip(changes, changes[1:])
+		if end - start >= MIN_REPORT_MS / 1000], is_cut
+
+# return: (the reports before the loop, the shortest run of reports that repeats itself over the rest)
+# For traces cut at the limit only: a command looping forever makes the same reports in every pass.
+# The first pass often differs at its start (a wait merged with the last one of the pass before).
+def findLoop(reports):
+	# the last report is cut by the end of the trace
+	body = reports[:-1]
+	best = None	# (start, period)
+	for period in range(1, len(body) // 2 + 1):
+		# the first report where every later one repeats the one a period before
+		i = len(body)
+		while i - period > 0 and body[i - 1] == body[i - 1 - period]:
+			i -= 1
+		start = max(0, i - period)
+		# two passes at the least, and the loop that takes in the most of the trace
+		if len(body) - start >= 2 * period and (best is None or start < best[0]):
+			best = (start, period)
+	if best is None:
+		return [], reports
+	start, period = best
+	return reports[:start], reports[start:start + period]
+
+# return: the reports as a list of (McuButton, duration) for Sender.uploadMacro()
+# Durations are kept in milliseconds, carrying what rounding leaves over to the next report.
+def compile(reports):
+	commands = []
+	carry = 0.0
+	for report, seconds in reports:
+		total = seconds * 1000 + carry
+		duration = max(1, round(total))
+		carry = total - duration
+
+		first = min(duration, MAX_COMMAND_MS)
+		if report in BUTTON_REPORTS:
+			commands.append((BUTTON_REPORTS[report], ms(first)))
+		else:
+			btn, hat, lx, ly, rx, ry = report
+			if (lx, ly) != (128, 128):
+				commands += stickL(lx, ly)
+			if (rx, ry) != (128, 128):
+				commands += stickR(rx, ry)
+			commands += press(btn, hat, ms(first))
+
+		# hold the report for the rest
+		duration -= first
+		while duration > 0:
+			commands.append((McuButton.OP_WAIT, ms(min(duration, MAX_COMMAND_MS))))
+			duration -= MAX_COMMAND_MS
+	return packRepeats(commands)
+
+# Fold runs of the same few commands into OP_REPEAT loops
+def packRepeats(commands, max_span=8):
+	packed = []
+	i = 0
+	while i < len(commands):
+		best_span, best_count = 1, 1
+		for span in range(1, max_span + 1):
+			block = commands[i:i + span]
+			count = 1
+			while commands[i + span * count:i + span * (count + 1)] == block:
+				count += 1
+			# a loop costs two commands of its own
+			if count > 1 and span * (count - 1) > 2 and span * (count - 1) > best_span * (best_count - 1):
+				best_span, best_count = span, count
+
+		if best_count > 1:
+			packed.append((McuButton.OP_REPEAT, best_count))
+			packed += commands[i:i + best_span]
+			packed.append((McuButton.OP_END, 0))
+		else:
+			packed.append(commands[i])
+		i += best_span * best_count
+	return packed
+
+BUTTON_NAMES = {int(b): 'SWITCH_' + b.name for b in Button}
+HAT_NAMES = {
+	Hat.TOP: 'HAT_TOP', Hat.TOP_RIGHT: 'HAT_TOP_RIGHT', Hat.RIGHT: 'HAT_RIGHT',
+	Hat.BTM_RIGHT: 'HAT_BOTTOM_RIGHT', Hat.BTM: 'HAT_BOTTOM', Hat.BTM_LEFT: 'HAT_BOTTOM_LEFT',
+	Hat.LEFT: 'HAT_LEFT', Hat.TOP_LEFT: 'HAT_TOP_LEFT', Hat.CENTER: 'HAT_CENTER',
+}
+
+def durationToC(duration):
+	return 'MS(' + str(duration & MAX_COMMAND_MS) + ')' if duration & 0x8000 else str(duration)
+
+# return: the commands as a Commands.c table named <name>_commands
+def toC(name, commands, is_oneshot=False):
+	lines = ['// register with ' + ('TABLE_ONESHOT' if is_oneshot else 'TABLE_LOOP') + ' in command_registry[]']
+	lines.append('const Command ' + name + '_commands[] PROGMEM = {')
+	i = 0
+	while i < len(commands):
+		btn, duration = commands[i]
+		if btn == McuButton.OP_PRESS:
+			hat, duration = commands[i + 1]
+			mask = ' | '.join(BUTTON_NAMES[b] for b in BUTTON_NAMES if b & commands[i][1]) or '0'
+			lines.append('\tPRESS(' + mask + ', ' + HAT_NAMES[Hat(hat)] + ', ' + durationToC(duration) + '),')
+			i += 2
+			continue
+		if btn in (McuButton.OP_STICK_L, McuButton.OP_STICK_R):
+			macro = 'STICK_L' if btn == McuButton.OP_STICK_L else 'STICK_R'
+			lines.append('\t' + macro + '(' + str(duration & 0xFF) + ', ' + str(duration >> 8) + '),')
+		elif btn == McuButton.OP_REPEAT:
+			lines.append('\t{ OP_REPEAT,\t' + str(duration) + ' },')
+		else:
+			lines.append('\t{ ' + btn.name + ',\t' + durationToC(duration) + ' },')
+		i += 1
+	lines.append('};')
+	lines.append('const int ' + name + '_size = (int)(sizeof(' + name + '_commands) / sizeof(Command));')
+	return '\n'.join(lines)
+
+# return: (commands, seconds they play, plays once?) of the command
+# A command that finishes compiles as a whole and is played once ("macro play <slot> once").
+# One cut at the limit keeps what it does before its loop and plays the loop MAX_REPEAT times
+# after it; the macro starts over only after that.
+def compileCommand(command, limit=600):
+	reports, is_cut = trace(command, limit)
+	if not is_cut:
+		commands = compile(reports)
+		seconds = sum(seconds for report, seconds in reports)
+	else:
+		head, loop = findLoop(reports)
+		seconds = sum(seconds for report, seconds in loop)
+		if head:
+			print('Note: the loop of ' + '{:.3f}'.format(seconds) + ' s plays ' + str(MAX_REPEAT) +
+				' times after the first ' + '{:.3f}'.format(sum(seconds for report, seconds in head)) + ' s')
+			commands = compile(head) + [(McuButton.OP_REPEAT, MAX_REPEAT)] + compile(loop) + [(McuButton.OP_END, 0)]
+		else:
+			commands = compile(loop)
+
+	if len(commands) > Protocol.MACRO_POOL_SIZE:
+		print('Warning: ' + str(len(commands)) + ' commands don\'t fit in the macro pool of ' +
+			str(Protocol.MACRO_POOL_SIZE) + ' (a Commands.c table still can hold them)')
+	return commands, seconds, not is_cut
@@ -1,19 +1,92 @@
 #!/usr/bin/env python3
 # -*- coding: utf-8 -*-
 
+from enum import IntEnum
 from . import CommandBase
 
+# Buttons of MCU commands
+# This needs to be the same as Buttons_t written in Joystick.h
+class McuButton(IntEnum):
+	UP			= 0
+	DOWN		= 1
+	LEFT		= 2
+	RIGHT		= 3
+	UPLEFT		= 4
+	UPRIGHT		= 5
+	DOWNLEFT	= 6
+	DOWNRIGHT	= 7
+	X			= 8
+	Y			= 9
+	A			= 10
+	B			= 11
+	L			= 12
+	R			= 13
+	PLUS		= 14
+	MINUS		= 15
+	NOP			= 16
+	TRIGGERS	= 17
+	HOME		= 18
+
+	# opcodes (see Commands.h)
+	OP_REPEAT	= 19	# (OP_REPEAT, n), ..., (OP_END, 0) plays the commands in between n times
+	OP_END		= 20
+	OP_CALL		= 21	# (OP_CALL, McuSubroutine) plays a table built into the firmware
+	OP_RET		= 22
+	OP_WAIT		= 23	# holds the last report, where NOP releases it
+	OP_PRESS	= 24	# use press() / report() below instead
+	OP_STICK_L	= 25
+	OP_STICK_R	= 26
+
+# Tables OP_CALL can play
+# This needs to be the same as Subroutine_id_t written in Commands.h
+class McuSubroutine(IntEnum):
+	SYNC			= 0
+	UNSYNC			= 1
+	TO_SETTINGS		= 2
+	TO_DATE_TIME	= 3
+
+# Durations in milliseconds instead of reports (see MS() in Commands.h)
+def ms(duration):
+	return 0x8000 | duration
+
+# Entries for any button mask (Keys.Button), HAT or stick position
+# These return lists, so join them into a command list with '+' (see PRESS() and REPORT() in Commands.h)
+def press(buttons, hat, duration):
+	return [(McuButton.OP_PRESS, int(buttons)), (int(hat), duration)]
+
+def stickL(x, y):
+	return [(McuButton.OP_STICK_L, x | (y << 8))]
+
+def stickR(x, y):
+	return [(McuButton.OP_STICK_R, x | (y << 8))]
+
+def report(buttons, hat, lx, ly, rx, ry, duration):
+	return stickL(lx, ly) + stickR(rx, ry) + press(buttons, hat, duration)
+
 # MCU command
+# Give 'commands' as a list of (McuButton, duration) to upload it to an EEPROM slot
+# and play it from there, instead of one built into the firmware (once: stop at the end)
 class McuCommand(CommandBase.Command):
-	def __init__(self, sync_name):
+	def __init__(self, sync_name, commands=None, slot=0, once=False):
 		super(McuCommand, self).__init__()
 		self.sync_name = sync_name
+		self.commands = commands
+		self.slot = slot
+		self.once = once
 		self.postProcess = None
 	
 	def start(self, ser, postProcess):
-		ser.writeRow(self.sync_name)
+		if self.commands is None:
+			ser.writeRow(self.sync_name)
+		elif not ser.uploadMacro(self.slot, self.commands):
+			print('failed to upload ' + self.sync_name + ' to the MCU')
+			return False
+		elif not ser.playMacro(self.slot, self.once):
+			print('the MCU refused to play ' + self.sync_name + ' from slot ' + str(self.slot))
+			return False
 		self.isRunning = True
 		self.postProcess = postProcess
+		return True
 
 	def end(self, ser):
 		ser.writeRow('end')
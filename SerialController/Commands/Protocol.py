@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Binary serial protocol
+# This needs to be the same as the one written in Protocol.h
+
+# [SYNC] [LEN] [TYPE] [PAYLOAD (LEN bytes)] [SUM]
+FRAME_SYNC = 0xF5
+FRAME_MAX_PAYLOAD = 16
+
+# frame types
+FRAME_REPORT = 0x01	# [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY]
+FRAME_QUEUE = 0x02	# report + [polls L] [polls H]
+FRAME_MACRO_BEGIN = 0x03	# [slot] [number of commands]
+FRAME_MACRO_DATA = 0x04		# ([button] [duration L] [duration H]) * n
+FRAME_MACRO_COMMIT = 0x05
+FRAME_DELTA = 0x06	# DELTA_* ops applied to the current report
+FRAME_QUEUE_REPEAT = 0x07	# [count L] [count H] [span]: the next span queued reports are played count times
+
+# frames sent by the MCU ("output on", ACK mode only)
+FRAME_OUTPUT_REPORT = 0x81	# [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY] of an OUT report from the Switch
+
+# entries of the MCU's input queue (INPUT_QUEUE_SIZE in InputQueue.h)
+INPUT_QUEUE_SIZE = 8
+
+# FRAME_DELTA ops
+DELTA_BUTTONS_SET = 0x01	# [mask L] [mask H]
+DELTA_BUTTONS_CLEAR = 0x02	# [mask L] [mask H]
+DELTA_HAT = 0x03			# [HAT]
+DELTA_STICK_L = 0x04		# [LX] [LY]
+DELTA_STICK_R = 0x05		# [RX] [RY]
+
+# EEPROM macros (see Macros.h)
+MACRO_SLOTS = 8
+MACRO_POOL_SIZE = 160
+MACRO_COMMAND_BYTES = 3
+EEPROM_WRITE_TIME = 0.0034	# seconds per byte
+
+# one-byte replies to handshakes ("binary", "baud")
+PROTO_ACK = 0x06
+PROTO_NAK = 0x15
+
+# one-byte replies in the ACK mode ("ack on"): ACK or NAK | 5-bit sequence number
+PROTO_SEQ_ACK = 0x80
+PROTO_SEQ_NAK = 0xA0
+PROTO_SEQ_MASK = 0x1F
+
+# credits ("credit on"): PROTO_CREDIT | free slots of the input queue,
+# sent after every reply and whenever playing frees slots
+PROTO_CREDIT = 0xC0
+PROTO_CREDIT_MASK = 0x0F
+
+def isSeqReply(b):
+	return b & 0xC0 == PROTO_SEQ_ACK
+
+def isCredit(b):
+	return b & 0xF0 == PROTO_CREDIT
+
+# slots of the input queue a frame built by frame() takes
+def frameSlots(data):
+	return 1 if len(data) > 2 and data[2] in (FRAME_QUEUE, FRAME_QUEUE_REPEAT) else 0
+
+# build a frame with the checksum (SUM is the low byte of LEN + TYPE + payload)
+def frame(type, payload=b''):
+	if len(payload) > FRAME_MAX_PAYLOAD:
+		raise ValueError('frame payload is too long: ' + str(len(payload)))
+
+	body = bytes([len(payload), type]) + bytes(payload)
+	return bytes([FRAME_SYNC]) + body + bytes([sum(body) & 0xFF])
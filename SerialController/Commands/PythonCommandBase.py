@@ -2,11 +2,18 @@
 # -*- coding: utf-8 -*-
 
 from abc import ABCMeta, abstractclassmethod
-from time import sleep
+from contextlib import contextmanager
+from time import sleep, perf_counter
+import queue
 import threading
 import cv2
 from .Keys import KeyPress, Button, Hat, Direction, Stick
-from . import CommandBase
+from . import CommandBase, Protocol
+from .Scheduler import Scheduler
+from . import TemplateCache
+
+# seconds a batch waits for the MCU queue to drain beyond the time it should take
+QUEUE_DRAIN_MARGIN = 1.0
 
 # the class For notifying stop signal is sent from Main window
 class StopThread(Exception):
@@ -20,6 +27,8 @@ class PythonCommand(CommandBase.Command):
 		self.thread = None
 		self.alive = True
 		self.postProcess = None
+		self.batching = False
+		self.scheduler = None
 
 	@abstractclassmethod
 	def do(self):
@@ -29,6 +38,11 @@ class PythonCommand(CommandBase.Command):
 		if self.keys is None:
 			self.keys = KeyPress(ser)
 
+		# every wait() is timed from here
+		self.scheduler = Scheduler()
+		self.scheduler.start()
+		ser.resetLatency()
+
 		try:
 			if self.alive:
 				self.do()
@@ -43,6 +57,11 @@ class PythonCommand(CommandBase.Command):
 			traceback.print_exc()
 			self.keys.end()
 			self.alive = False
+		finally:
+			self.scheduler.stop()
+			self.scheduler.printStats()
+			ser.disableOutputReports()
+			ser.printLatency()
 
 	def start(self, ser, postProcess=None):
 		self.alive = True
@@ -50,6 +69,7 @@ class PythonCommand(CommandBase.Command):
 		if not self.thread:
 			self.thread = threading.Thread(target=self.do_safe, args=(ser,))
 			self.thread.start()
+		return True
 
 	def end(self, ser):
 		self.sendStopRequest()
@@ -64,35 +84,141 @@ class PythonCommand(CommandBase.Command):
 		self.alive = False
 		self.end(self.keys.ser)
 
+	# Send every input in the block in one write onto the MCU's input queue (needs the binary mode)
+	# Durations stay in seconds and are rounded to USB polls (see Sender.poll_interval).
+	# The block returns once the MCU has played all of them: with credits (see Sender.enableCredits)
+	# when its queue has drained, which also streams batches longer than the queue; otherwise
+	# after the polls they take, counted from when the last byte is on the wire.
+	# e.g.
+	#	with self.batch():
+	#		self.press(Button.A, wait=0.5)
+	#		self.pressRep(Direction.DOWN, 10)
+	@contextmanager
+	def batch(self):
+		if self.batching:
+			yield
+			return
+
+		ser = self.keys.ser
+		self.keys.takeQueued()
+		self.batching = True
+		ser.beginBatch()
+		written = 0
+		try:
+			yield
+		finally:
+			self.batching = False
+			written = ser.endBatch()
+
+		entries, polls = self.keys.takeQueued()
+		play_time = ser.transmitTime(written) + polls * ser.poll_interval
+		if ser.credits is None:
+			if entries > Protocol.INPUT_QUEUE_SIZE:
+				print('Warning: a batch of ' + str(entries) + ' inputs overflows the MCU queue of ' +
+					str(Protocol.INPUT_QUEUE_SIZE))
+			self.sleep(play_time)
+		else:
+			# a lost credit byte would keep the count short of the whole queue
+			if not ser.waitForQueueDrained(play_time + QUEUE_DRAIN_MARGIN, lambda: not self.alive) and self.alive:
+				print('Warning: the MCU queue has not drained ' + '{:.3f}'.format(play_time) + ' s after a batch')
+			self.resync()
+		self.checkIfAlive()
+
+	# Durations in a batch are queued as USB polls
+	# return: (frames, *durations) to use
+	def toFrames(self, frames, *durations):
+		if frames or not self.batching:
+			return (frames,) + durations
+		poll_interval = self.keys.ser.poll_interval
+		return (True,) + tuple(round(d / poll_interval) for d in durations)
+
 	# press button at duration times(s)
-	def press(self, buttons, duration=0.1, wait=0.1):
+	# With frames=True, duration and wait are numbers of USB polls and the inputs are
+	# queued on the MCU instead of sleeping here (needs the binary mode)
+	def press(self, buttons, duration=0.1, wait=0.1, frames=False):
+		frames, duration, wait = self.toFrames(frames, duration, wait)
+		if frames:
+			self.keys.input(buttons, polls=duration)
+			self.keys.inputEnd(buttons, polls=wait)
+			self.checkIfAlive()
+			return
+
 		self.keys.input(buttons)
-		self.wait(duration)
+		self.sleep(duration, is_hold=True)
+		self.checkIfAlive()
 		self.keys.inputEnd(buttons)
 		self.wait(wait)
 		self.checkIfAlive()
 
 	# press button at duration times(s) repeatedly
-	def pressRep(self, buttons, repeat, duration=0.1, interval=0.1, wait=0.1):
+	# With batch=True in the binary mode, the presses are played by a loop on the MCU
+	# (with the durations rounded to USB polls, see batch())
+	def pressRep(self, buttons, repeat, duration=0.1, interval=0.1, wait=0.1, frames=False, batch=False):
+		if batch and not frames and not self.batching and self.keys.ser.is_binary:
+			with self.batch():
+				self.pressRep(buttons, repeat, duration, interval, wait)
+			return
+
+		frames, duration, interval, wait = self.toFrames(frames, duration, interval, wait)
+		if frames:
+			# the last release is held for the wait
+			if repeat > 1:
+				self.keys.repeat(repeat - 1, 2)
+				self.press(buttons, duration, interval, frames)
+			if repeat > 0:
+				self.press(buttons, duration, wait, frames)
+			return
+
 		for i in range(0, repeat):
 			self.press(buttons, duration, 0 if i == repeat - 1 else interval)
 		self.wait(wait)
 
 	# add hold buttons
-	def hold(self, buttons, wait=0.1):
+	def hold(self, buttons, wait=0.1, frames=False):
+		frames, wait = self.toFrames(frames, wait)
+		if frames:
+			self.keys.hold(buttons, polls=wait)
+			self.checkIfAlive()
+			return
+
 		self.keys.hold(buttons)
 		self.wait(wait)
 
 	# release holding buttons
-	def holdEnd(self, buttons):
-		self.keys.holdEnd(buttons)
+	# With frames=True, the release is queued and held for wait USB polls
+	def holdEnd(self, buttons, wait=0, frames=False):
+		frames, wait = self.toFrames(frames, wait)
+		if frames:
+			self.keys.holdEnd(buttons, polls=wait)
+		else:
+			self.keys.holdEnd(buttons)
+			if wait > 0:
+				self.wait(wait)
 		self.checkIfAlive()
 
 	# do nothing at wait time(s)
-	def wait(self, wait):
-		sleep(wait)
+	# Waits end on deadlines counted from the start of the command, so they don't drift over a script.
+	# With frames=True, the current input is queued and held for wait USB polls
+	def wait(self, wait, frames=False):
+		frames, wait = self.toFrames(frames, wait)
+		if frames:
+			self.keys.send(polls=wait)
+		else:
+			self.sleep(wait)
 		self.checkIfAlive()
 
+	# is_hold: a button is held meanwhile, which is never cut short by lag (see Scheduler)
+	def sleep(self, wait, is_hold=False):
+		if self.scheduler is None:
+			sleep(wait)
+		else:
+			self.scheduler.wait(wait, is_hold)
+
+	# Call after blocking outside wait() (see Scheduler.resync())
+	def resync(self):
+		if self.scheduler is not None:
+			self.scheduler.resync()
+
 	def checkIfAlive(self):
 		if not self.alive:
 			self.keys.end()
@@ -108,6 +234,27 @@ class PythonCommand(CommandBase.Command):
 		else:
 			return True
 
+	# Wait for the next OUT report the Switch sends to the controller (rumble, LEDs)
+	# They come through the MCU as they change (needs the ACK mode), so this reacts to the game
+	# on the frame it happens instead of on the next camera capture.
+	# Forwarding starts at the first call and only reports from then on are returned.
+	# return: the Sender.OutputReport, or None after timeout seconds (None: wait forever)
+	def waitOutputReport(self, timeout=None):
+		ser = self.keys.ser
+		if not ser.is_output and not ser.enableOutputReports():
+			return None
+
+		deadline = None if timeout is None else perf_counter() + timeout
+		while True:
+			# wake up now and then to see if the command has been stopped
+			left = 0.1 if deadline is None else min(0.1, deadline - perf_counter())
+			if left <= 0:
+				return None
+			try:
+				return ser.output_reports.get(timeout=left)
+			except queue.Empty:
+				self.checkIfAlive()
+
 	# Use time glitch
 	# Controls the system time and get every-other-day bonus without any punishments
 	def timeLeap(self, is_go_back=True):
@@ -154,33 +301,46 @@ class PythonCommand(CommandBase.Command):
 		self.press(Button.HOME, wait=1)
 		self.press(Button.HOME, wait=1)
 
-TEMPLATE_PATH = "./Template/"
+TEMPLATE_PATH = TemplateCache.TEMPLATE_PATH
+# a coarse match this much under the threshold is still checked at full resolution
+PYRAMID_SLACK = 0.15
+# templates smaller than this at the coarse level are matched at full resolution only
+PYRAMID_MIN_SIZE = 8
+
 class ImageProcPythonCommand(PythonCommand):
 	def __init__(self, cam):
 		super(ImageProcPythonCommand, self).__init__()
 		self.camera = cam
+		self.templates = TemplateCache.cache
+
+	def start(self, ser, postProcess=None):
+		# decode templates here instead of in the matching loops
+		self.templates.preload()
+		return super().start(ser, postProcess)
 
 	# Judge if current screenshot contains an image using template matching
 	# It's recommended that you use gray_scale option unless the template color wouldn't be cared for performace
 	# 現在のスクリーンショットと指定した画像のテンプレートマッチングを行います
 	# 色の違いを考慮しないのであればパフォーマンスの点からuse_grayをTrueにしてグレースケール画像を使うことを推奨します
-	def isContainTemplate(self, template_path, threshold=0.7, use_gray=True, show_value=False):
-		src = self.camera.readFrame()
-		src = cv2.cvtColor(src, cv2.COLOR_BGR2GRAY) if use_gray else src
-
-		template = cv2.imread(TEMPLATE_PATH+template_path, cv2.IMREAD_GRAYSCALE if use_gray else cv2.IMREAD_COLOR)
-		w, h = template.shape[1], template.shape[0]
-
-		method = cv2.TM_CCOEFF_NORMED
-		res = cv2.matchTemplate(src, template, method)
-		_, max_val, _, max_loc = cv2.minMaxLoc(res)
+	#
+	# roi: (x, y, width, height) of the capture to search in (the region set by TemplateCache.setRoi() by default)
+	# pyramid: match at 1/2^pyramid resolution first and refine only around the best candidate
+	# roi: 探索するキャプチャ上の領域 (x, y, 幅, 高さ)
+	# pyramid: 1/2^pyramidの解像度で大まかに探索してから候補の周辺だけを元の解像度で探索します
+	def isContainTemplate(self, template_path, threshold=0.7, use_gray=True, show_value=False, roi=None, pyramid=0):
+		src, max_val, max_loc = self.matchFrame(self.camera.readFrame(), template_path, threshold, use_gray, roi, pyramid)
+		# matching takes a while, which the next wait shouldn't make up for
+		self.resync()
 
 		if show_value:
 			print(template_path + ' ZNCC value: ' + str(max_val))
 
 		if max_val > threshold:
-			if use_gray:
-				src = cv2.cvtColor(src, cv2.COLOR_GRAY2BGR)
+			template = self.templates.get(template_path, use_gray)
+			w, h = template.shape[1], template.shape[0]
+
+			# the color frame is shared with the camera
+			src = cv2.cvtColor(src, cv2.COLOR_GRAY2BGR) if use_gray else src.copy()
 
 			top_left = max_loc
 			bottom_right = (top_left[0] + w, top_left[1] + h)
@@ -189,6 +349,126 @@ class ImageProcPythonCommand(PythonCommand):
 		else:
 			return False
 
+	# Wait for the template to show up and return on the first frame it's found in
+	# A fixed wait() before isContainTemplate() has to cover the slowest screen transition; this
+	# looks at every frame the camera grabs and returns as soon as the game gets there.
+	# With after_input, frames captured before the last input was sent don't count,
+	# so the screen a press is about to leave can't match.
+	# 指定した画像が映るまで取り込まれるフレームを順に調べ、見つかった時点で戻ります
+	#
+	# timeout: seconds to give up after (None: wait forever)
+	# return: seconds from the last input to the capture of the matching frame, or None on timeout
+	#         (0 is a match too, so test it with "is None")
+	def waitUntil(self, template_path, timeout=10, roi=None, threshold=0.7, use_gray=True, pyramid=0, show_value=False, after_input=True):
+		try:
+			for frame, delay in self.newFrames(timeout, after_input):
+				_, max_val, _ = self.matchFrame(frame, template_path, threshold, use_gray, roi, pyramid)
+				if show_value:
+					print(template_path + ' ZNCC value: ' + str(max_val) + ' at ' + '{:.3f}'.format(delay) + ' s')
+				if max_val > threshold:
+					return delay
+			return None
+		finally:
+			# this has blocked outside the scheduler, so the next press() starts from now
+			self.resync()
+
+	# Wait for the screen to stop changing, for loading and animations of unknown length
+	# The screen is still once still_frames frames in a row have no more than max_pixels
+	# pixels moving by getInterframeDiff() of each and the two before it.
+	# 画面(のroi)が動かなくなるまで待ちます
+	#
+	# return: seconds from the last input to the capture of the frame the screen was still on, or None on timeout
+	def waitStill(self, timeout=10, roi=None, still_frames=3, threshold=20, max_pixels=50, after_input=True):
+		history = []
+		still = 0
+		try:
+			for frame, delay in self.newFrames(timeout, after_input):
+				if roi is not None:
+					x, y, w, h = roi
+					frame = frame[y:y + h, x:x + w]
+				history = history[-2:] + [cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)]
+				if len(history) < 3:
+					continue
+
+				mask = self.getInterframeDiff(history[0], history[1], history[2], threshold)
+				still = still + 1 if cv2.countNonZero(mask) <= max_pixels else 0
+				if still >= still_frames:
+					return delay
+			return None
+		finally:
+			self.resync()
+
+	# Yield (frame, seconds from the last input to its capture) of every new frame the camera grabs
+	# until timeout seconds have passed (None: forever), leaving out those captured before the last input
+	# with after_input. Frames the caller is too slow for are skipped, not queued.
+	def newFrames(self, timeout, after_input):
+		ser = self.keys.ser
+		input_time = ser.last_write_time
+		deadline = None if timeout is None else perf_counter() + timeout
+		number = 0
+		while True:
+			# wake up now and then to see if the command has been stopped
+			left = 0.1 if deadline is None else min(0.1, deadline - perf_counter())
+			if left <= 0:
+				return
+
+			frame, captured, new_number = self.camera.waitNewFrame(number, left)
+			if new_number == number or frame is None:
+				# nothing to wait on without the grabber
+				if not self.camera.is_grabbing:
+					sleep(left)
+				self.checkIfAlive()
+				continue
+
+			number = new_number
+			if not after_input or captured >= input_time:
+				yield frame, captured - input_time
+			self.checkIfAlive()
+
+	# return: (the searched part of the frame, max_val, max_loc) of the best match of the template
+	def matchFrame(self, src, template_path, threshold, use_gray, roi, pyramid):
+		roi = roi if roi is not None else self.templates.getRoi(template_path)
+		if roi is not None:
+			x, y, w, h = roi
+			src = src[y:y + h, x:x + w]
+		src = cv2.cvtColor(src, cv2.COLOR_BGR2GRAY) if use_gray else src
+
+		template = self.templates.get(template_path, use_gray)
+		w, h = template.shape[1], template.shape[0]
+
+		if pyramid > 0 and min(w, h) >> pyramid >= PYRAMID_MIN_SIZE:
+			max_val, max_loc = self.matchPyramid(src, template_path, use_gray, pyramid, threshold - PYRAMID_SLACK)
+		else:
+			res = cv2.matchTemplate(src, template, cv2.TM_CCOEFF_NORMED)
+			_, max_val, _, max_loc = cv2.minMaxLoc(res)
+		return src, max_val, max_loc
+
+	# return: (max_val, max_loc) of the match refined at full resolution around the best coarse one
+	def matchPyramid(self, src, template_path, use_gray, level, coarse_threshold):
+		coarse_src = src
+		for i in range(level):
+			coarse_src = cv2.pyrDown(coarse_src)
+		coarse_template = self.templates.get(template_path, use_gray, level)
+
+		res = cv2.matchTemplate(coarse_src, coarse_template, cv2.TM_CCOEFF_NORMED)
+		_, coarse_val, _, coarse_loc = cv2.minMaxLoc(res)
+		if coarse_val < coarse_threshold:
+			return coarse_val, coarse_loc
+
+		# a coarse pixel covers 2^level pixels, so search a little wider than that
+		template = self.templates.get(template_path, use_gray)
+		w, h = template.shape[1], template.shape[0]
+		scale = 1 << level
+		margin = scale * 2
+		x0 = max(0, coarse_loc[0] * scale - margin)
+		y0 = max(0, coarse_loc[1] * scale - margin)
+		x1 = min(src.shape[1], coarse_loc[0] * scale + w + margin)
+		y1 = min(src.shape[0], coarse_loc[1] * scale + h + margin)
+
+		res = cv2.matchTemplate(src[y0:y1, x0:x1], template, cv2.TM_CCOEFF_NORMED)
+		_, max_val, _, max_loc = cv2.minMaxLoc(res)
+		return max_val, (max_loc[0] + x0, max_loc[1] + y0)
+
 	# Get interframe difference binarized image
 	# フレーム間差分により2値化された画像を取得
 	def getInterframeDiff(self, frame1, frame2, frame3, threshold):
@@ -37,8 +37,7 @@ class AutoHatching(ImageProcPythonCommand):
 					self.hold([Direction.RIGHT, Direction.R_LEFT])
 
 					# turn round and round
-					while not self.isContainTemplate('egg_notice.png'):
-						self.wait(1)
+					self.waitUntil('egg_notice.png', timeout=None)
 
 					print('egg hatching')
 					self.holdEnd([Direction.RIGHT, Direction.R_LEFT])
@@ -102,8 +101,8 @@ class AutoHatching(ImageProcPythonCommand):
 			self.press(Button.B, wait=1.5)
 
 	def getNewEgg(self):
-		self.press(Button.A, wait=0.5)
-		if not self.isContainTemplate('egg_found.png'):
+		self.press(Button.A, wait=0)
+		if self.waitUntil('egg_found.png', timeout=0.5) is None:
 			print('egg not found')
 			self.finish() # TODO
 		print('egg found')
@@ -30,8 +30,8 @@ class Fossil_shiny(ImageProcPythonCommand):
 				self.press(Button.A, wait=0.75) # determine fossil
 
 				self.press(Button.A, wait=0.75) # select "それでよければ"
-				while not self.isContainTemplate('Network_Offline.png', 0.8):
-					self.press(Button.B, wait=0.5)
+				while self.waitUntil('Network_Offline.png', timeout=0.5, threshold=0.8) is None:
+					self.press(Button.B, wait=0)
 				self.wait(1.0)
 
 			# open up pokemon box
@@ -52,11 +52,9 @@ class Fossil_shiny(ImageProcPythonCommand):
 			self.press(Button.A, wait=2.5)  # closed
 			self.press(Button.A, wait=2.0)  # Choose game
 			self.press(Button.A)  # User selection
-			while not self.isContainTemplate('OP.png', 0.7): # recognize Opening
-				self.wait(0.2)
+			self.waitUntil('OP.png', timeout=None, threshold=0.7) # recognize Opening
 			self.press(Button.A)  # load save-data
-			while not self.isContainTemplate('Network_Offline.png', 0.8):
-				self.wait(0.5)
+			self.waitUntil('Network_Offline.png', timeout=None, threshold=0.8)
 			self.wait(1.0)
 			i += 1
 
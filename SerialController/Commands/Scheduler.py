@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+import os
+import time
+
+# Waits on absolute deadlines counted from the start of a command,
+# so small errors of every wait don't pile up over a long script
+# A wait that starts late is shortened by the lag, except for holds of a press,
+# which are part of the input: they run in full and leave the lag to the waits after them.
+class Scheduler:
+	def __init__(self, resync_after=1.0):
+		self.origin = None
+		self.deadline = None
+		# start over from now when a wait starts later than this behind its deadline
+		self.resync_after = resync_after
+		self.is_period_set = False
+
+		self.wait_count = 0
+		self.overshoot_total = 0
+		self.overshoot_max = 0
+		self.resync_count = 0
+		self.late_hold_count = 0
+		self.last_overshoot = 0
+
+	def start(self):
+		# Windows sleeps in steps of about 15 ms by default
+		if os.name == 'nt':
+			try:
+				import ctypes
+				self.is_period_set = ctypes.windll.winmm.timeBeginPeriod(1) == 0
+			except (ImportError, AttributeError, OSError):
+				self.is_period_set = False
+
+		# the spin-wait covers the part time.sleep() may oversleep
+		self.spin_margin = 0.002 if os.name != 'nt' or self.is_period_set else 0.016
+
+		self.origin = time.perf_counter()
+		self.deadline = self.origin
+
+	def stop(self):
+		if self.is_period_set:
+			import ctypes
+			ctypes.windll.winmm.timeEndPeriod(1)
+			self.is_period_set = False
+
+	# Wait until 'seconds' after the previous deadline
+	# is_hold: a button is held for these seconds, so wait no less than that from now
+	def wait(self, seconds, is_hold=False):
+		if self.origin is None:
+			self.start()
+
+		now = time.perf_counter()
+		self.deadline += seconds
+		if now - self.deadline > self.resync_after:
+			self.deadline = now + seconds
+			self.resync_count += 1
+
+		end = self.deadline
+		if is_hold and now + seconds > end:
+			end = now + seconds
+			self.late_hold_count += 1
+
+		remaining = end - now
+		if remaining > self.spin_margin:
+			time.sleep(remaining - self.spin_margin)
+		# give up the GIL on every turn, or the spin holds up the other devices' command threads
+		# (Runner) and the camera grabber for all of spin_margin
+		while time.perf_counter() < end:
+			time.sleep(0)
+
+		self.last_overshoot = time.perf_counter() - end
+		self.wait_count += 1
+		self.overshoot_total += self.last_overshoot
+		if self.last_overshoot > self.overshoot_max:
+			self.overshoot_max = self.last_overshoot
+
+	# Count the next deadline from now, for callers that have blocked outside the scheduler
+	# (waiting for an image, the serial line, ...), so the wait after them isn't cut short
+	def resync(self):
+		if self.origin is None:
+			self.start()
+		self.deadline = time.perf_counter()
+
+	# seconds since start()
+	def elapsed(self):
+		return time.perf_counter() - self.origin
+
+	def printStats(self):
+		if self.wait_count == 0:
+			return
+
+		print('waits: {}, overshoot avg: {:.2f} ms, max: {:.2f} ms, resyncs: {}, late holds: {}'.format(
+			self.wait_count, self.overshoot_total / self.wait_count * 1000,
+			self.overshoot_max * 1000, self.resync_count, self.late_hold_count))
@@ -2,22 +2,120 @@
 # -*- coding: utf-8 -*-
 
 import os
+import collections
+import queue
+import struct
+import threading
+import time
 import serial
+from . import InputTrace, Protocol
+from .Keys import POLL_INTERVAL
+
+# The MCU starts at this rate (see SERIAL_BAUD in Protocol.h)
+DEFAULT_BAUDRATE = 9600
+# Rates the MCU accepts for "baud"
+BAUDRATES = [9600, 19200, 38400, 57600, 115200, 250000, 500000, 1000000]
+# Ask the MCU for its credits again after waiting this long for them with nothing in flight
+CREDIT_TIMEOUT = 1.0
+
+# OUT reports forwarded by the MCU kept until read; the oldest are dropped beyond this
+OUTPUT_QUEUE_SIZE = 64
+
+# An OUT report the Switch sent to the controller (rumble, LEDs), in the layout of the input report
+# time is time.perf_counter() when it arrived
+OutputReport = collections.namedtuple('OutputReport', 'time button hat lx ly rx ry')
+
+# Counts intervals into buckets up to these bounds (seconds)
+class LatencyHistogram:
+	BOUNDS = [0.0001, 0.0002, 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1]
+
+	def __init__(self, name):
+		self.name = name
+		self.reset()
+
+	def reset(self):
+		self.buckets = [0] * (len(self.BOUNDS) + 1)
+		self.count = 0
+		self.total = 0
+		self.max = 0
+
+	def add(self, t):
+		i = 0
+		while i < len(self.BOUNDS) and t > self.BOUNDS[i]:
+			i += 1
+		self.buckets[i] += 1
+		self.count += 1
+		self.total += t
+		self.max = t if t > self.max else self.max
+
+	def print(self):
+		if self.count == 0:
+			return
+
+		print('{}: {} samples, avg: {:.2f} ms, max: {:.2f} ms'.format(
+			self.name, self.count, self.total / self.count * 1000, self.max * 1000))
+		lower = 0
+		for bound, n in zip(self.BOUNDS + [None], self.buckets):
+			if n > 0:
+				upper = '{:g} ms'.format(bound * 1000) if bound is not None else 'more'
+				print('  {:>8} - {:<8}: {}'.format('{:g} ms'.format(lower * 1000), upper, n))
+			lower = bound
 
 class Sender:
 	def __init__(self, is_show_serial):
 		self.ser = None
 		self.is_show_serial = is_show_serial
+		self.is_binary = False
+
+		# ACK mode
+		self.is_ack = False
+		self.ack_window = 0
+		self.ack_timeout = 0
+		self.in_flight = collections.deque()	# sequence numbers waiting for the reply
+		self.next_seq = 0
+		self.reply_deadline = 0
+		self.ack_cond = threading.Condition()
+		self.reader = None
+		self.nak_count = 0
+		self.lost_count = 0
+
+		# Credits: free slots of the MCU's input queue that may still be filled (None without them)
+		self.credits = None
+		self.credit_updates = 0
+		self.in_flight_slots = {}	# sequence number -> slots its frame takes
+
+		# seconds between polls of the console, measured by measurePollInterval()
+		self.poll_interval = POLL_INTERVAL
+		self.rate_reply = None	# the last "rate" line from the MCU
+
+		# OUT reports forwarded by the MCU ("output on")
+		self.is_output = False
+		self.output_reports = queue.Queue(OUTPUT_QUEUE_SIZE)
+
+		# Latency
+		self.write_latency = LatencyHistogram('serial write')
+		# from the end of the write to the reply, which covers the line and parsing on the MCU
+		self.reply_latency = LatencyHistogram('reply')
+		self.written_at = {}	# sequence number -> when its write finished
+		# time.perf_counter() when the last line or frame was written, to time camera frames against
+		self.last_write_time = 0
+
+		# (bytes, slots) of lines and frames held back until endBatch() (None when not batching)
+		self.batch = None
+
+		# the reports sent are written here by startRecording() (None when not recording)
+		self.recorder = None
 
-	def openSerial(self, portNum):
+	def openSerial(self, portNum, baudrate=DEFAULT_BAUDRATE):
+		self.is_binary = False
 		try:
 			if os.name == 'nt':
 				print('connecting to ' + "COM" + str(portNum))
-				self.ser = serial.Serial("COM" + str(portNum), 9600)
+				self.ser = serial.Serial("COM" + str(portNum), baudrate)
 				return True
 			elif os.name == 'posix':
 				print('connecting to ' + "/dev/ttyUSB" + str(portNum))
-				self.ser = serial.Serial("/dev/ttyUSB" + str(portNum), 9600)
+				self.ser = serial.Serial("/dev/ttyUSB" + str(portNum), baudrate)
 				return True
 			else:
 				print('not supported OS')
@@ -28,19 +126,549 @@ class Sender:
 			return False
 				
 	def closeSerial(self):
+		self.stopRecording()
+		self.disableAck()
+		# the MCU keeps running while the host is away, so bring it back to the rate it starts at
+		if self.ser.baudrate != DEFAULT_BAUDRATE:
+			self.changeBaudrate(DEFAULT_BAUDRATE)
 		self.ser.close()
 	
 	def isOpened(self):
 		return not self.ser is None and self.ser.isOpen()
 
-	def writeRow(self, row):
+	# Switch the MCU into binary frame mode
+	# Falls back to the text format if the firmware doesn't answer to the handshake
+	def enableBinary(self, timeout=0.1):
+		try:
+			self.ser.reset_input_buffer()
+			self.writeRow('binary')
+
+			# the MCU may echo the line before acknowledging it
+			self.ser.timeout = timeout
+			res = self.ser.read_until(bytes([Protocol.PROTO_ACK]), 32)
+			self.ser.timeout = None
+		except serial.serialutil.SerialException as e:
+			print(e)
+			return False
+		except AttributeError:
+			print('Attempting to use a port that is not open')
+			return False
+
+		self.is_binary = len(res) > 0 and res[-1] == Protocol.PROTO_ACK
+		if not self.is_binary:
+			# old firmwares treat unknown commands as debug macros, so stop it
+			self.writeRow('end')
+			print('binary mode is not supported by the MCU, using text mode')
+
+		return self.is_binary
+
+	# Switch both the MCU and the port to another baud rate
+	# The MCU acknowledges at the current rate and switches right after that
+	def changeBaudrate(self, baudrate, timeout=0.1):
+		if baudrate not in BAUDRATES:
+			print('unsupported baud rate: ' + str(baudrate))
+			return False
+
+		try:
+			self.ser.reset_input_buffer()
+			# no line feed here since it would arrive while the MCU is switching
+			self.ser.write(('baud ' + str(baudrate) + '\r').encode('utf-8'))
+
+			self.ser.timeout = timeout
+			res = self.ser.read_until(bytes([Protocol.PROTO_ACK]), 32)
+			self.ser.timeout = None
+		except serial.serialutil.SerialException as e:
+			print(e)
+			return False
+		except AttributeError:
+			print('Attempting to use a port that is not open')
+			return False
+
+		if len(res) == 0 or res[-1] != Protocol.PROTO_ACK:
+			self.writeRow('end')
+			print('the MCU refused to change the baud rate to ' + str(baudrate))
+			return False
+
+		self.ser.baudrate = baudrate
+		print('baud rate changed to ' + str(baudrate))
+		return True
+
+	# Let the MCU answer every line and frame with a sequence-numbered ACK/NAK
+	# instead of echoing it, and keep up to 'window' of them in flight
+	def enableAck(self, window=4, timeout=0.5):
+		try:
+			self.ser.reset_input_buffer()
+			self.writeRow('ack on')
+
+			self.ser.timeout = timeout
+			res = self.ser.read(1)
+			while len(res) > 0 and not Protocol.isSeqReply(res[0]):
+				res = self.ser.read(1)
+			self.ser.timeout = None
+		except serial.serialutil.SerialException as e:
+			print(e)
+			return False
+		except AttributeError:
+			print('Attempting to use a port that is not open')
+			return False
+
+		if len(res) == 0 or res[0] != Protocol.PROTO_SEQ_ACK:
+			self.writeRow('end')
+			print('ACK mode is not supported by the MCU, sending without flow control')
+			return False
+
+		self.is_ack = True
+		self.ack_window = window
+		self.ack_timeout = timeout
+		self.in_flight.clear()
+		self.next_seq = 1
+		self.nak_count = 0
+		self.lost_count = 0
+
+		self.reader = threading.Thread(target=self.readReplies, daemon=True)
+		self.reader.start()
+		return True
+
+	# Let the MCU advertise the free slots of its input queue, so that queued frames
+	# wait here rather than overflow it and a batch can be longer than the queue
+	def enableCredits(self, timeout=0.5):
+		if not self.is_ack:
+			return False
+
+		with self.ack_cond:
+			self.credits = 0
+			updates = self.credit_updates
+		self.writeRow('credit on')
+
+		# the count comes right after the reply
+		with self.ack_cond:
+			if not self.ack_cond.wait_for(lambda: self.credit_updates != updates, timeout):
+				self.credits = None
+		if self.credits is None:
+			# old firmwares play unknown commands as debug tables
+			self.writeRow('end')
+			print('credits are not supported by the MCU')
+			return False
+		return True
+
+	# Let the MCU forward the OUT reports the Switch sends, which arrive in output_reports
+	# Reports from before this call are dropped.
+	def enableOutputReports(self):
+		if not self.is_ack:
+			return False
+
+		with self.ack_cond:
+			naks = self.nak_count
+		self.writeRow('output on')
+		self.waitForReplies()
+		self.clearOutputReports()
+
+		if self.nak_count != naks:
+			self.writeRow('end')
+			print('forwarding OUT reports is not supported by the MCU')
+			return False
+		self.is_output = True
+		return True
+
+	def disableOutputReports(self):
+		if not self.is_output:
+			return
+		self.is_output = False
+		self.writeRow('output off')
+
+	def clearOutputReports(self):
 		try:
-			self.ser.write((row+'\r\n').encode('utf-8'))
+			while True:
+				self.output_reports.get_nowait()
+		except queue.Empty:
+			pass
+
+	def disableAck(self):
+		if not self.is_ack:
+			return
+
+		with self.ack_cond:
+			self.is_ack = False
+			self.is_output = False
+			self.credits = None
+			self.ack_cond.notify_all()
+		self.reader.join()
+		self.reader = None
+		# no reply comes to this line
+		self.writeRow('ack off')
+
+		if self.nak_count > 0 or self.lost_count > 0:
+			print('rejected: ' + str(self.nak_count) + ', lost: ' + str(self.lost_count))
+
+	# Runs on its own thread in the ACK mode
+	# Splits the replies and frames from the text the MCU prints (e.g. "stats")
+	def readReplies(self):
+		self.ser.timeout = 0.05
+		text = bytearray()
+		frame = bytearray()	# frame being received, from FRAME_SYNC on
+
+		while self.is_ack:
+			try:
+				data = self.ser.read(max(1, self.ser.in_waiting))
+			except serial.serialutil.SerialException as e:
+				print(e)
+				break
+
+			for b in data:
+				if len(frame) > 0:
+					frame.append(b)
+					if frame[1] > Protocol.FRAME_MAX_PAYLOAD:
+						print('broken frame from the MCU')
+						frame.clear()
+					elif len(frame) == frame[1] + 4:
+						self.onFrame(bytes(frame))
+						frame.clear()
+				elif b == Protocol.FRAME_SYNC:
+					frame.append(b)
+				elif Protocol.isSeqReply(b):
+					self.onReply(b)
+				elif Protocol.isCredit(b):
+					self.onCredit(b & Protocol.PROTO_CREDIT_MASK)
+				elif b == ord('\n'):
+					self.onText(text.decode('utf-8', 'replace').rstrip('\r'))
+					text.clear()
+				else:
+					text.append(b)
+
+			if len(data) == 0:
+				self.expireInFlight()
+
+		self.ser.timeout = None
+
+	def onText(self, line):
+		print(line)
+		# "rate <ms> polls <n> ms <ms>"
+		words = line.split()
+		if len(words) == 6 and words[0] == 'rate':
+			with self.ack_cond:
+				self.rate_reply = (int(words[1]), int(words[3]), int(words[5]))
+				self.ack_cond.notify_all()
+
+	# data: the whole frame, [SYNC] [LEN] [TYPE] [PAYLOAD] [SUM]
+	def onFrame(self, data):
+		if sum(data[1:-1]) & 0xFF != data[-1]:
+			print('broken frame from the MCU')
+			return
+
+		type, payload = data[2], data[3:-1]
+		if type == Protocol.FRAME_OUTPUT_REPORT and len(payload) == 7:
+			button, hat, lx, ly, rx, ry = struct.unpack('<H5B', payload)
+			report = OutputReport(time.perf_counter(), button, hat, lx, ly, rx, ry)
+			# nobody may be reading them, so keep the latest ones
+			while True:
+				try:
+					self.output_reports.put_nowait(report)
+					break
+				except queue.Full:
+					try:
+						self.output_reports.get_nowait()
+					except queue.Empty:
+						pass
+
+	def onReply(self, b):
+		seq = b & Protocol.PROTO_SEQ_MASK
+		with self.ack_cond:
+			if seq in self.in_flight:
+				# replies before this one have been lost on the way back
+				while self.in_flight[0] != seq:
+					lost = self.in_flight.popleft()
+					self.written_at.pop(lost, None)
+					self.in_flight_slots.pop(lost, None)
+				self.in_flight.popleft()
+				self.in_flight_slots.pop(seq, None)
+
+				written_at = self.written_at.pop(seq, None)
+				if written_at is not None:
+					self.reply_latency.add(time.perf_counter() - written_at)
+			if b & ~Protocol.PROTO_SEQ_MASK == Protocol.PROTO_SEQ_NAK:
+				self.nak_count += 1
+				print('the MCU rejected input #' + str(seq))
+			self.ack_cond.notify_all()
+
+	# free slots counted by the MCU after everything it has answered so far
+	def onCredit(self, free):
+		with self.ack_cond:
+			if self.credits is None:
+				return
+			self.credits = free - sum(self.in_flight_slots.get(seq, 0) for seq in self.in_flight)
+			self.credit_updates += 1
+			self.ack_cond.notify_all()
+
+	# Nothing has come back for a while, so the input still in flight never arrived
+	def expireInFlight(self):
+		with self.ack_cond:
+			if len(self.in_flight) == 0 or time.monotonic() < self.reply_deadline:
+				return
+			self.lost_count += len(self.in_flight)
+			print('no reply to ' + str(len(self.in_flight)) + ' input(s)')
+			# the MCU numbers its replies, not the input, so start over from what it will send next
+			self.next_seq = (self.next_seq - len(self.in_flight)) & Protocol.PROTO_SEQ_MASK
+			self.in_flight.clear()
+			self.written_at.clear()
+			self.in_flight_slots.clear()
+			# whether the lost frames have been queued is unknown, so wait for a new count
+			if self.credits is not None:
+				self.credits = 0
+			self.ack_cond.notify_all()
+
+	# return: how many of items[start:] fit in the window and the credits now
+	# Without credits a batch waits for the whole window if it can't fit in what's left
+	def countFitting(self, items, start):
+		if self.credits is None:
+			count = len(items) - start
+			return count if len(self.in_flight) + count <= self.ack_window or len(self.in_flight) == 0 else 0
+
+		count = 0
+		credits = self.credits
+		while start + count < len(items) and len(self.in_flight) + count < self.ack_window:
+			slots = items[start + count][1]
+			if slots > credits:
+				break
+			credits -= slots
+			count += 1
+		return count
+
+	# Block until items[start] of (bytes, slots) fits, then count it and as many of
+	# the following ones as fit in flight
+	# reply_timeout overrides ack_timeout for input the MCU takes long to process
+	# return: how many items have been counted
+	def reserve(self, items, start, reply_timeout=None):
+		while True:
+			with self.ack_cond:
+				self.ack_cond.wait_for(lambda: not self.is_ack or self.countFitting(items, start) > 0,
+					CREDIT_TIMEOUT)
+				if not self.is_ack:
+					return len(items) - start
+
+				count = self.countFitting(items, start)
+				if count > 0:
+					for data, slots in items[start:start + count]:
+						self.in_flight.append(self.next_seq)
+						self.in_flight_slots[self.next_seq] = slots
+						self.next_seq = (self.next_seq + 1) & Protocol.PROTO_SEQ_MASK
+						if self.credits is not None:
+							self.credits -= slots
+					timeout = self.ack_timeout if reply_timeout is None else reply_timeout
+					self.reply_deadline = max(self.reply_deadline, time.monotonic() + timeout)
+					return count
+
+				# the count may be out of date after lost replies
+				is_stale = self.credits is not None and len(self.in_flight) == 0
+
+			if is_stale:
+				print('no credits from the MCU for a while, asking again')
+				self.writeRow('credit on')
+
+	# Write items of (bytes, slots), as many at a time as the window and the credits allow
+	def writeItems(self, items, reply_timeout=None):
+		start = 0
+		while start < len(items):
+			count = self.reserve(items, start, reply_timeout)
+			self.write(b''.join(data for data, slots in items[start:start + count]), count)
+			start += count
+
+	# Block until every line and frame in flight has been answered (or given up on)
+	def waitForReplies(self):
+		if not self.is_ack:
+			return
+
+		with self.ack_cond:
+			self.ack_cond.wait_for(lambda: len(self.in_flight) == 0 or not self.is_ack)
+
+	# Hold back lines and frames written from now on and send them in one write by endBatch()
+	# With credits, endBatch() streams the batch as the MCU's queue makes room for it
+	def beginBatch(self):
+		self.batch = []
+
+	# return: the bytes written
+	def endBatch(self):
+		items = self.batch
+		self.batch = None
+		if not items:
+			return 0
+		self.writeItems(items)
+		return sum(len(data) for data, slots in items)
+
+	# seconds the port takes to shift out n bytes (8N1: 10 bits a byte)
+	def transmitTime(self, n):
+		return n * 10 / self.ser.baudrate if self.ser is not None else 0
+
+	# Block until the MCU has played out its input queue, which it tells by giving back all of
+	# its slots as credits (needs enableCredits). is_stopped is asked in between, as in replay().
+	# return: the queue has drained within timeout?
+	def waitForQueueDrained(self, timeout, is_stopped=None):
+		deadline = time.monotonic() + timeout
+		with self.ack_cond:
+			while self.credits is None or len(self.in_flight) > 0 or self.credits < Protocol.INPUT_QUEUE_SIZE:
+				left = deadline - time.monotonic()
+				if self.credits is None or left <= 0 or (is_stopped is not None and is_stopped()):
+					return False
+				self.ack_cond.wait(min(left, 0.1))
+		return True
+
+	# Write the last count lines and frames counted by reserve()
+	def write(self, data, count=1):
+		try:
+			start = time.perf_counter()
+			self.ser.write(data)
+			end = time.perf_counter()
 		except serial.serialutil.SerialException as e:
 			print(e)
+			return
 		except AttributeError:
 			print('Attempting to use a port that is not open')
+			return
+
+		self.write_latency.add(end - start)
+		self.last_write_time = end
+		if self.is_ack:
+			with self.ack_cond:
+				for seq in list(self.in_flight)[-count:]:
+					self.written_at.setdefault(seq, end)
+
+	# Ask the MCU for another report rate profile (1, 4, 5 or 8 ms between polls)
+	# It enumerates again, so the console may take a moment to use the controller again.
+	# return: the MCU has accepted it? (always True without the ACK mode)
+	def setPollRate(self, interval_ms):
+		with self.ack_cond:
+			naks = self.nak_count
+		self.writeRow('rate ' + str(interval_ms))
+		self.waitForReplies()
+		return self.nak_count == naks
+
+	# Count the reports the console takes for a while and keep the interval in poll_interval,
+	# which is what queued durations are counted in (needs the ACK mode to read the count)
+	# return: seconds between polls, or None if nothing came back
+	def measurePollInterval(self, period=1.0, timeout=0.5):
+		if not self.is_ack:
+			return None
+
+		# the first line starts the count over
+		self.writeRow('rate')
+		self.waitForReplies()
+		time.sleep(period)
+		with self.ack_cond:
+			self.rate_reply = None
+		self.writeRow('rate')
+		with self.ack_cond:
+			self.ack_cond.wait_for(lambda: self.rate_reply is not None, timeout)
+			reply = self.rate_reply
+
+		if reply is None or reply[1] == 0:
+			print('the console took no reports')
+			return None
+		interval_ms, polls, ms = reply
+		self.poll_interval = ms / polls / 1000
+		print('report rate ' + str(interval_ms) + ' ms, polled every ' +
+			'{:.2f}'.format(self.poll_interval * 1000) + ' ms')
+		return self.poll_interval
+
+	# Record every report KeyPress sends from now on into a binary trace (see InputTrace)
+	# It can be played back with InputTrace.replay() or fed to the host simulation.
+	def startRecording(self, path):
+		self.stopRecording()
+		self.recorder = InputTrace.TraceWriter(path, self.poll_interval)
+		print('recording the inputs to ' + path)
+
+	def stopRecording(self):
+		if self.recorder is None:
+			return
+		self.recorder.close()
+		print('recorded ' + str(self.recorder.count) + ' reports')
+		self.recorder = None
+
+	# polls: the USB polls a queued report is held for (None: sent at once)
+	def recordReport(self, report, polls=None):
+		if self.recorder is not None:
+			self.recorder.add(report, polls)
+
+	def resetLatency(self):
+		self.write_latency.reset()
+		self.reply_latency.reset()
+		if self.is_ack:
+			self.writeRow('stats reset')
+
+	# The MCU times the rest (parsing and the next poll) and prints it to "stats",
+	# which can only be read back in the ACK mode
+	def printLatency(self):
+		self.write_latency.print()
+		self.reply_latency.print()
+		if self.is_ack:
+			self.writeRow('stats')
+
+	def writeRow(self, row):
+		data = (row+'\r\n').encode('utf-8')
+		if self.batch is not None:
+			self.batch.append((data, 0))
+			if self.is_show_serial.get():
+				print(row)
+			return
+
+		self.writeItems([(data, 0)])
 
 		# Show sending serial datas
 		if self.is_show_serial.get():
 			print(row)
+
+	def writeFrame(self, frame, reply_timeout=None):
+		if self.batch is not None:
+			self.batch.append((frame, Protocol.frameSlots(frame)))
+			if self.is_show_serial.get():
+				print(frame.hex(' '))
+			return
+
+		self.writeItems([(frame, Protocol.frameSlots(frame))], reply_timeout)
+
+		# Show sending serial datas
+		if self.is_show_serial.get():
+			print(frame.hex(' '))
+
+	# Upload a list of (McuButton, duration) into an EEPROM macro slot of the MCU
+	# The MCU can't receive while writing EEPROM, so every frame waits until it has been written.
+	# return: the MCU has accepted the macro? (always True without the ACK mode)
+	def uploadMacro(self, slot, commands):
+		if not self.is_binary:
+			print('uploading macros needs the binary mode')
+			return False
+		if not 0 < len(commands) <= 255:
+			print('a macro needs 1 to 255 commands')
+			return False
+
+		nak_count = self.nak_count
+		per = Protocol.FRAME_MAX_PAYLOAD // Protocol.MACRO_COMMAND_BYTES
+
+		# starting may move every other macro in the pool
+		pending = self.writeEepromFrame(Protocol.FRAME_MACRO_BEGIN, bytes([slot, len(commands)]),
+			Protocol.MACRO_POOL_SIZE * Protocol.MACRO_COMMAND_BYTES, 0)
+		for i in range(0, len(commands), per):
+			chunk = commands[i:i + per]
+			payload = b''.join(struct.pack('<BH', int(btn), duration) for btn, duration in chunk)
+			pending = self.writeEepromFrame(Protocol.FRAME_MACRO_DATA, payload, len(payload), pending)
+		self.writeEepromFrame(Protocol.FRAME_MACRO_COMMIT, b'', 3, pending)
+
+		return self.nak_count == nak_count
+
+	# return: the MCU has accepted it? (always True without the ACK mode)
+	def playMacro(self, slot, once=False):
+		with self.ack_cond:
+			naks = self.nak_count
+		self.writeRow('macro play ' + str(slot) + (' once' if once else ''))
+		self.waitForReplies()
+		return self.nak_count == naks
+
+	# The MCU replies to a frame before it writes the EEPROM, and takes no input until it has,
+	# so the reply may wait for the pending_bytes of the frame before.
+	# return: eeprom_bytes, to give the next frame
+	def writeEepromFrame(self, type, payload, eeprom_bytes, pending_bytes):
+		write_time = eeprom_bytes * Protocol.EEPROM_WRITE_TIME
+		self.writeFrame(Protocol.frame(type, payload), self.ack_timeout + pending_bytes * Protocol.EEPROM_WRITE_TIME)
+		if self.is_ack:
+			self.waitForReplies()
+		else:
+			time.sleep(write_time)
+		return eeprom_bytes
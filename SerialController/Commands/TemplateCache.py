@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+import os
+import threading
+import cv2
+import Utility as util
+
+TEMPLATE_PATH = "./Template/"
+
+# Template images decoded once and kept in memory
+# Keyed by (path, use_gray) so the gray and color versions of a file are stored separately
+class TemplateCache:
+	def __init__(self, base_path=TEMPLATE_PATH):
+		self.base_path = base_path
+		self.templates = {}
+		self.lock = threading.Lock()
+
+		# regions (x, y, width, height) of the capture where each template shows up
+		self.rois = {}
+
+	# level: times the image is halved by cv2.pyrDown() (for coarse-to-fine matching)
+	def get(self, template_path, use_gray=True, level=0):
+		key = (template_path, use_gray, level)
+		template = self.templates.get(key)
+		if template is None:
+			if level == 0:
+				template = self.load(template_path, use_gray)
+			else:
+				template = cv2.pyrDown(self.get(template_path, use_gray, level - 1))
+			with self.lock:
+				self.templates[key] = template
+		return template
+
+	# Match the template only in this region of the capture unless a command asks for another one
+	def setRoi(self, template_path, roi):
+		self.rois[template_path] = roi
+
+	def getRoi(self, template_path):
+		return self.rois.get(template_path)
+
+	def load(self, template_path, use_gray):
+		template = cv2.imread(os.path.join(self.base_path, template_path),
+			cv2.IMREAD_GRAYSCALE if use_gray else cv2.IMREAD_COLOR)
+		if template is None:
+			raise FileNotFoundError('template not found: ' + os.path.join(self.base_path, template_path))
+		return template
+
+	# Load every image under the template directory (gray scale is what most commands use)
+	def preload(self, use_gray=True):
+		for name in util.browseFileNames(self.base_path, ext='.png'):
+			self.get(name.replace(os.sep, '/'), use_gray)
+
+	# Forget every image (but not the regions), e.g. after the templates have been edited
+	def clear(self):
+		with self.lock:
+			self.templates.clear()
+
+# shared by all commands
+cache = TemplateCache()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Compiles a PythonCommand into a macro the MCU plays with its own timing
+# e.g. python CompileMacro.py InfinityWatt -c infinity_watt     prints a table for Commands.c
+#      python CompileMacro.py InfinityWatt -u 3 -s 0 --play      uploads it to slot 0 of COM3 and plays it
+
+import argparse
+import Utility as util
+from CommandLoader import CommandLoader
+from Runner import Flag
+from Commands import MacroCompiler, PythonCommandBase, Sender
+
+def main():
+	parser = argparse.ArgumentParser(description='Compile a Python command that only presses and waits into an MCU macro')
+	parser.add_argument('command', help='command class name in Commands/PythonCommands')
+	parser.add_argument('-t', '--max-time', type=float, default=600, help='seconds to trace a command that never ends')
+	parser.add_argument('-c', '--c-table', metavar='NAME', help='print a Commands.c table named NAME_commands')
+	parser.add_argument('-u', '--upload', type=int, metavar='PORT', help='upload the macro to the MCU on COM PORT')
+	parser.add_argument('-s', '--slot', type=int, default=0)
+	parser.add_argument('--play', action='store_true', help='play the macro after uploading it')
+	args = parser.parse_args()
+
+	loader = CommandLoader(util.ospath('Commands/PythonCommands'), PythonCommandBase.PythonCommand)
+	classes = {c.__name__: c for c in loader.load()}
+	if args.command not in classes:
+		parser.error('unknown command (' + ', '.join(sorted(classes.keys())) + ')')
+
+	command_class = classes[args.command]
+	# image processing ones still compile as long as they never look at the camera
+	if issubclass(command_class, PythonCommandBase.ImageProcPythonCommand):
+		command = command_class(None)
+	else:
+		command = command_class()
+
+	try:
+		commands, seconds, is_oneshot = MacroCompiler.compileCommand(command, args.max_time)
+	except MacroCompiler.NotCompilable as e:
+		print(args.command + ' can\'t be compiled: ' + str(e))
+		return
+	print(args.command + ': ' + str(len(commands)) + ' commands, ' + '{:.3f}'.format(seconds) + ' s' +
+		(', played once' if is_oneshot else ' a pass of the loop'))
+
+	if args.c_table is not None:
+		print(MacroCompiler.toC(args.c_table, commands, is_oneshot))
+
+	if args.upload is not None:
+		ser = Sender.Sender(Flag())
+		if not ser.openSerial(args.upload):
+			return
+		if not ser.enableBinary():
+			print('the MCU has no binary mode to upload macros with')
+			ser.closeSerial()
+			return
+		# without the ACK mode every frame just waits out the EEPROM writes
+		ser.enableAck()
+		if ser.uploadMacro(args.slot, commands):
+			print('uploaded to slot ' + str(args.slot))
+			if args.play and not ser.playMacro(args.slot, is_oneshot):
+				print('the MCU refused to play slot ' + str(args.slot))
+		else:
+			print('failed to upload the macro')
+		ser.closeSerial()
+
+if __name__ == "__main__":
+	main()
@@ -39,7 +39,8 @@ class CaptureArea(tk.Label):
 
 	def capture(self):
 		if self.is_show_var.get():
-			image_bgr = self.camera.readFrame()
+			# never blocks the Tk thread, with or without frames coming
+			image_bgr = self.camera.readFrameInfo()[0]
 		else:
 			self.after(self.next_frames, self.capture)
 			return
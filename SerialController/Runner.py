@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Headless runner that drives several controllers from one process
+# e.g. python Runner.py -c AutoHatching 3:0 4:1 5:2=FossilShiny
+#   each device is PORT[:CAMERA][=COMMAND], where COMMAND is a class name in Commands/PythonCommands
+#   --record DIR writes the inputs of each device to DIR/COM<PORT>.trace, and
+#   --replay TRACE plays one of those on every device instead of a command
+
+import argparse
+import os
+import signal
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+import Utility as util
+from Camera import Camera
+from CommandLoader import CommandLoader
+from Commands import InputTrace, PythonCommandBase, Sender, TemplateCache
+
+# stands in for the tk variable the GUI gives Sender
+class Flag:
+	def __init__(self, value=False):
+		self.value = value
+
+	def get(self):
+		return self.value
+
+	def set(self, value):
+		self.value = value
+
+class Device:
+	def __init__(self, port, camera_id, command_name):
+		self.port = port
+		self.camera_id = camera_id
+		self.command_name = command_name
+		self.ser = None
+		self.camera = None
+		self.command = None
+		self.replay_path = None
+		self.is_stopped = False
+
+	def __repr__(self):
+		return 'COM{}/camera {}/{}'.format(self.port, self.camera_id, self.command_name)
+
+	def open(self, command_class, baudrate, show_serial, poll_ms=None, record_dir=None):
+		self.ser = Sender.Sender(show_serial)
+		if not self.ser.openSerial(self.port):
+			return False
+
+		# the same negotiation as the GUI does
+		if self.ser.enableBinary() and baudrate != Sender.DEFAULT_BAUDRATE:
+			self.ser.changeBaudrate(baudrate)
+		if self.ser.enableAck():
+			self.ser.enableCredits()
+			if poll_ms is not None and self.ser.setPollRate(poll_ms):
+				# wait for the console to take the controller again
+				time.sleep(2)
+			self.ser.measurePollInterval()
+		if record_dir is not None:
+			self.ser.startRecording(os.path.join(record_dir, 'COM' + str(self.port) + '.trace'))
+
+		if command_class is None:
+			return True
+		if issubclass(command_class, PythonCommandBase.ImageProcPythonCommand):
+			if self.camera_id is None:
+				print(str(self) + ': this command needs a camera')
+				return False
+			self.camera = Camera()
+			self.camera.openCamera(self.camera_id)
+			self.command = command_class(self.camera)
+		else:
+			self.command = command_class()
+		return True
+
+	def run(self):
+		if self.replay_path is not None:
+			sent = InputTrace.replay(self.ser, self.replay_path, lambda: self.is_stopped)
+			print(str(self) + ': replayed ' + str(sent) + ' reports')
+		else:
+			self.command.do_safe(self.ser)
+
+	def stop(self):
+		self.is_stopped = True
+		if self.command is not None:
+			self.command.sendStopRequest()
+
+	def close(self):
+		if self.ser is not None and self.ser.isOpened():
+			self.ser.closeSerial()
+		if self.camera is not None:
+			self.camera.destroy()
+
+def parseDevice(arg, default_command):
+	command = default_command
+	if '=' in arg:
+		arg, command = arg.split('=', 1)
+
+	port, _, camera = arg.partition(':')
+	return Device(int(port), int(camera) if camera else None, command)
+
+def main():
+	parser = argparse.ArgumentParser(description='Run Python commands on several controllers without the GUI')
+	parser.add_argument('devices', nargs='+', help='PORT[:CAMERA][=COMMAND]')
+	parser.add_argument('-c', '--command', help='command class for devices without =COMMAND')
+	parser.add_argument('-b', '--baud', type=int, default=Sender.DEFAULT_BAUDRATE)
+	parser.add_argument('-s', '--show-serial', action='store_true')
+	parser.add_argument('-r', '--poll-rate', type=int, choices=[1, 4, 5, 8], help='report rate profile in ms between polls')
+	parser.add_argument('--record', metavar='DIR', help='record the inputs sent to each device')
+	parser.add_argument('--replay', metavar='TRACE', help='play a recorded trace instead of a command')
+	args = parser.parse_args()
+
+	loader = CommandLoader(util.ospath('Commands/PythonCommands'), PythonCommandBase.PythonCommand)
+	classes = {c.__name__: c for c in loader.load()}
+
+	devices = [parseDevice(arg, args.command) for arg in args.devices]
+	for device in devices:
+		if args.replay is not None:
+			device.command_name = 'replay'
+			device.replay_path = args.replay
+		elif device.command_name not in classes:
+			parser.error(str(device) + ': unknown command (' + ', '.join(sorted(classes.keys())) + ')')
+
+	# templates are decoded once for all devices
+	TemplateCache.cache.preload()
+
+	show_serial = Flag(args.show_serial)
+	if args.record is not None:
+		os.makedirs(args.record, exist_ok=True)
+	opened = [d for d in devices if d.open(classes.get(d.command_name),
+		args.baud, show_serial, args.poll_rate, args.record)]
+	if len(opened) < len(devices):
+		print('running ' + str(len(opened)) + ' of ' + str(len(devices)) + ' devices')
+
+	# Ctrl+C asks every command to stop at its next wait
+	stop_event = threading.Event()
+	def onInterrupt(signum, frame):
+		print('stopping all commands')
+		stop_event.set()
+		for device in opened:
+			device.stop()
+	signal.signal(signal.SIGINT, onInterrupt)
+
+	try:
+		with ThreadPoolExecutor(max_workers=max(1, len(opened))) as pool:
+			futures = [pool.submit(device.run) for device in opened]
+			while not all(f.done() for f in futures):
+				stop_event.wait(0.5)
+	finally:
+		for device in opened:
+			device.close()
+
+if __name__ == "__main__":
+	main()
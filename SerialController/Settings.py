@@ -11,6 +11,7 @@ class GuiSettings:
 		# default values
 		self.camera_id = tk.IntVar(value=0)
 		self.com_port = tk.IntVar(value=0)
+		self.baud_rate = tk.IntVar(value=9600)
 		self.fps = tk.StringVar(value='45')
 		self.is_show_realtime = tk.BooleanVar(value=True)
 		self.is_show_serial = tk.BooleanVar(value=False)
@@ -20,19 +21,18 @@ class GuiSettings:
 		if os.path.isfile(self.SETTING_PATH):
 			load_settings = pickle.load(open(self.SETTING_PATH, 'rb'))
 
-			# deserialize
-			deserialized = {key:value[1](value=value[0]) for key, value in load_settings.items()}
+			# deserialize into the defaults, so items added since the file was saved keep
+			# their default values and the saved ones aren't lost
+			for key, value in load_settings.items():
+				if key in self.__dict__ and type(self.__dict__[key]) is value[1]:
+					self.__dict__[key].set(value[0])
 
-			if self.__dict__.keys() != deserialized.keys():
+			if self.__dict__.keys() != load_settings.keys():
 				print('Setting items have been altered.')
-				self.generate()
-				self.load()
-			else:
-				self.__dict__ = deserialized
+				self.save()
 		else:
 			print('No setting files can be found.')
 			self.generate()
-			self.load()
 
 	def generate(self):
 		self.save()
@@ -11,7 +11,7 @@ from Keyboard import SwitchKeyboardController
 from Camera import Camera
 from GuiAssets import MyScrolledText, CaptureArea, ControllerGUI
 import Utility as util
-from Commands import PythonCommandBase, McuCommandBase, Sender
+from Commands import PythonCommandBase, McuCommandBase, Sender, TemplateCache
 from Commands.Keys import KeyPress
 from CommandLoader import CommandLoader
 
@@ -105,6 +105,11 @@ class GUI:
 			offvalue=False,
 			variable=self.settings.is_show_serial)
 
+		# baud rate negotiated after the port is opened
+		self.label_baud = ttk.Label(self.serial_f2, text='Baud:')
+		self.baud_cb = ttk.Combobox(self.serial_f2, textvariable=self.settings.baud_rate, width=7, state="readonly")
+		self.baud_cb['values'] = Sender.BAUDRATES
+
 		# simple controller
 		self.cb_use_keyboard = ttk.Checkbutton(
 			self.control_lf, text='Use Keyboard',
@@ -157,6 +162,8 @@ class GUI:
 		self.entry2.pack(side=tk.LEFT, padx=5)
 		self.reloadComPort.pack(side=tk.LEFT)
 		self.cb_show_ser.pack(side=tk.LEFT)
+		self.label_baud.pack(side=tk.LEFT)
+		self.baud_cb.pack(side=tk.LEFT, padx=5)
 
 		# controller simulator
 		self.control_lf.grid(row=1, column=1, sticky='ne')
@@ -197,7 +204,8 @@ class GUI:
 		self.assignCommand()
 
 		print(self.startButton["text"] + ' ' + self.cur_command.NAME)
-		self.cur_command.start(self.ser, self.stopPlayPost)
+		if not self.cur_command.start(self.ser, self.stopPlayPost):
+			return
 
 		self.startButton["text"] = "Stop"
 		self.startButton["command"] = self.stopPlay
@@ -277,6 +285,15 @@ class GUI:
 		else:
 			if self.ser.openSerial(self.settings.com_port.get()):
 				print('COM Port ' + str(self.settings.com_port.get()) + ' connected successfully')
+				if self.ser.enableBinary():
+					print('binary mode enabled')
+				if self.settings.baud_rate.get() != Sender.DEFAULT_BAUDRATE:
+					self.ser.changeBaudrate(self.settings.baud_rate.get())
+				if self.ser.enableAck():
+					print('ACK mode enabled')
+					if self.ser.enableCredits():
+						print('credits enabled')
+					self.ser.measurePollInterval()
 				self.keyPress = KeyPress(self.ser)
 
 	def createControllerWindow(self):
@@ -367,6 +384,8 @@ class GUI:
 
 		self.py_classes = self.py_loader.reload()
 		self.mcu_classes = self.mcu_loader.reload()
+		# templates may have been edited as well
+		TemplateCache.cache.clear()
 
 		# Restore the command selecting state if possible
 		self.setCommandItems()
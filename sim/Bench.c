@@ -0,0 +1,180 @@
+/*
+Microbenchmarks of the firmware core
+
+Times the parsers and GetNextReport() on the host, so protocol changes can be
+compared offline. Host nanoseconds aren't AVR cycles, but the ratios between
+the cases follow the code; the bytes column gives the time on the wire,
+which is usually what limits the input rate.
+
+usage: bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Hooks.h"
+#include "Protocol.h"
+#include "InputQueue.h"
+
+// Firmware internals without a header
+bool ParseLine(char* line);
+bool ReceiveByte(const char c);
+
+static long iterations = 200000;
+
+static double Now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void Send(const uint8_t* const data, const uint16_t len)
+{
+	for (uint16_t i = 0; i < len; i++)
+		ReceiveByte(data[i]);
+}
+
+static void SendLine(const char* const line)
+{
+	Send((const uint8_t*)line, strlen(line));
+	Send((const uint8_t*)"\r\n", 2);
+}
+
+static uint16_t MakeFrame(uint8_t* const out, const uint8_t type, const uint8_t* const payload, const uint8_t len)
+{
+	out[0] = FRAME_SYNC;
+	out[1] = len;
+	out[2] = type;
+	memcpy(out + 3, payload, len);
+	uint8_t sum = 0;
+	for (uint8_t i = 1; i < len + 3; i++)
+		sum += out[i];
+	out[len + 3] = sum;
+	return len + 4;
+}
+
+static void PrintHeader(const char* const title)
+{
+	printf("\n%s\n", title);
+	printf("  %-24s %8s %6s %12s %12s\n", "case", "ns", "bytes", "wire@9600", "wire@1M");
+}
+
+static void PrintResult(const char* const name, const double seconds, const uint16_t bytes)
+{
+	printf("  %-24s %8.1f", name, seconds / iterations * 1e9);
+	if (bytes > 0)
+		printf(" %6u %9.2f ms %9.2f us", bytes, bytes * 10 / 9600.0 * 1000, bytes * 10 / 1e6 * 1e6);
+	printf("\n");
+}
+
+// ParseLine() alone; the line is parsed where it lies, as SerialTask() does
+static void BenchParseLine(const char* const name, const char* const line)
+{
+	char buf[32];
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+
+	const double start = Now();
+	for (long i = 0; i < iterations; i++)
+		ParseLine(buf);
+	PrintResult(name, Now() - start, strlen(line) + 2);
+}
+
+// Every byte through ReceiveByte(), as the main loop takes them from the ring buffer
+static void BenchReceive(const char* const name, const uint8_t* const data, const uint16_t len, const bool is_queue)
+{
+	const double start = Now();
+	for (long i = 0; i < iterations; i++)
+	{
+		Send(data, len);
+		// queued frames would fill the queue and be rejected from then on
+		if (is_queue)
+			ClearInputQueue();
+	}
+	PrintResult(name, Now() - start, len);
+}
+
+static void BenchReceiveText(void)
+{
+	const char* const text = "12 8 ff 80\r\n";
+	BenchReceive("text report", (const uint8_t*)text, strlen(text), false);
+}
+
+static void BenchReceiveFrames(void)
+{
+	uint8_t frame[FRAME_MAX_PAYLOAD + 4];
+	uint16_t len;
+	const uint8_t report[] = { 0x04, 0x00, 0x08, 0xFF, 0x80, 0x80, 0x80 };
+	const uint8_t queue[] = { 0x04, 0x00, 0x08, 0xFF, 0x80, 0x80, 0x80, 0x03, 0x00 };
+	const uint8_t delta[] = { DELTA_BUTTONS_SET, 0x04, 0x00 };
+	const uint8_t delta_stick[] = { DELTA_STICK_L, 0xFF, 0x80 };
+
+	BenchReceiveText();
+	len = MakeFrame(frame, FRAME_REPORT, report, sizeof(report));
+	BenchReceive("FRAME_REPORT", frame, len, false);
+	len = MakeFrame(frame, FRAME_DELTA, delta, sizeof(delta));
+	BenchReceive("FRAME_DELTA buttons", frame, len, false);
+	len = MakeFrame(frame, FRAME_DELTA, delta_stick, sizeof(delta_stick));
+	BenchReceive("FRAME_DELTA stick", frame, len, false);
+	len = MakeFrame(frame, FRAME_QUEUE, queue, sizeof(queue));
+	BenchReceive("FRAME_QUEUE", frame, len, true);
+}
+
+static void BenchPoll(const char* const name)
+{
+	USB_JoystickReport_Input_t report;
+
+	const double start = Now();
+	for (long i = 0; i < iterations; i++)
+		GetNextReport(&report);
+	PrintResult(name, Now() - start, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+		iterations = atol(argv[1]);
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 2;
+	}
+
+	// start the firmware from reset and leave it right after the first pass of the main loop
+	SimRunFirmware(0);
+	printf("%ld iterations\n", iterations);
+
+	PrintHeader("ParseLine()");
+	BenchParseLine("text report", "12 8 ff 80");
+	BenchParseLine("text report with sticks", "13 8 ff 80 0 80");
+	BenchParseLine("table by name", "mash_a");
+	BenchParseLine("end", "end");
+
+	// frames are only accepted after the handshake
+	PrintHeader("ReceiveByte(), text mode");
+	BenchReceiveText();
+
+	SendLine("binary");
+	PrintHeader("ReceiveByte(), binary mode");
+	BenchReceiveFrames();
+
+	SendLine("ack on");
+	PrintHeader("ReceiveByte(), binary mode with ACK");
+	BenchReceiveFrames();
+	SendLine("ack off");
+
+	PrintHeader("GetNextReport()");
+	SendLine("12 8 ff 80");
+	BenchPoll("PC report");
+	SendLine("mash_a");
+	BenchPoll("table mash_a");
+	SendLine("auto_league");
+	BenchPoll("table auto_league");
+	SendLine("inf_watt");
+	BenchPoll("table inf_watt");
+	SendLine("end");
+	BenchPoll("idle");
+
+	return 0;
+}
@@ -0,0 +1,363 @@
+/*
+Host stand-ins for the hardware the firmware touches
+
+The stub headers in sim/stubs turn registers into globals and LUFA calls into
+the functions below. USB_USBTask() runs once per pass of the main loop, so it
+advances the simulated clock and delivers what happened in the meantime:
+serial bytes (through the RX interrupt), SOF ticks, Timer1 overflows, Timer0
+compare matches, IN polls and OUT packets.
+*/
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <LUFA/Drivers/Peripheral/Serial.h>
+#include "Hooks.h"
+
+uint32_t sim_us = 0;
+uint32_t sim_poll_us = 8000;
+uint32_t sim_loop_us = 20;
+uint32_t sim_baud = SERIAL_BAUD;
+
+uint32_t sim_missed_polls = 0;
+uint32_t sim_poll_count = 0;
+
+void (*sim_on_report)(const USB_JoystickReport_Input_t* const report) = NULL;
+void (*sim_on_tx)(const uint8_t c) = NULL;
+void (*sim_on_ports)(const uint8_t portb, const uint8_t portd) = NULL;
+static uint8_t last_portb = 0;
+
+// Registers
+volatile uint8_t  UDR1, UCSR1A, UCSR1B, UCSR1C;
+volatile uint16_t UBRR1;
+volatile uint8_t  DDRB, PORTB, DDRD, PORTD;
+volatile uint8_t  MCUSR;
+volatile uint8_t  TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t TCNT1;
+volatile uint8_t  TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+volatile uint8_t  UEINTX;
+
+volatile uint8_t USB_DeviceState = DEVICE_STATE_Unattached;
+USB_Request_Header_t USB_ControlRequest;
+
+// Serial line from the host
+#define SIM_RX_SIZE 65536
+static uint8_t rx_data[SIM_RX_SIZE];
+static uint32_t rx_at[SIM_RX_SIZE]; // when each byte may start being sent
+static uint32_t rx_count = 0;
+static uint32_t rx_pos = 0;
+static uint32_t rx_line_free_us = 0; // when the byte on the wire has been received
+
+void SimSend(const uint32_t at_us, const uint8_t* const data, const uint16_t len)
+{
+	for (uint16_t i = 0; i < len && rx_count < SIM_RX_SIZE; i++)
+	{
+		rx_data[rx_count] = data[i];
+		rx_at[rx_count] = at_us;
+		rx_count++;
+	}
+}
+
+bool SimIsSerialIdle(void)
+{
+	return rx_pos == rx_count;
+}
+
+static void DeliverSerial(void)
+{
+	while (rx_pos < rx_count)
+	{
+		// start bit, 8 data bits and a stop bit
+		const uint32_t byte_us = 10000000UL / sim_baud;
+		const uint32_t start = rx_at[rx_pos] > rx_line_free_us ? rx_at[rx_pos] : rx_line_free_us;
+		if (start + byte_us > sim_us)
+			return;
+
+		rx_line_free_us = start + byte_us;
+		UDR1 = rx_data[rx_pos++];
+		if (UCSR1B & (1 << RXCIE1))
+			USART1_RX_vect();
+	}
+}
+
+// Serial line to the host
+void Serial_Init(uint32_t BaudRate, bool DoubleSpeed)
+{
+	sim_baud = BaudRate;
+	UCSR1B = (1 << RXEN1) | (1 << TXEN1);
+}
+
+void Serial_CreateStream(FILE* Stream)
+{
+}
+
+void Serial_SendByte(char DataByte)
+{
+	if (sim_on_tx != NULL)
+		sim_on_tx((uint8_t)DataByte);
+}
+
+bool Serial_IsSendReady(void)
+{
+	return true;
+}
+
+bool Serial_IsSendComplete(void)
+{
+	return true;
+}
+
+int16_t Serial_ReceiveByte(void)
+{
+	return -1;
+}
+
+int SimPrintf(const char* format, ...)
+{
+	char buf[256];
+	va_list args;
+
+	va_start(args, format);
+	int len = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+
+	for (int i = 0; i < len && i < (int)sizeof(buf) - 1; i++)
+		Serial_SendByte(buf[i]);
+	return len;
+}
+
+// Timer1 at the CPU clock
+static uint32_t timer_cycles = 0;
+
+static void AdvanceTimer(void)
+{
+	const uint32_t cycles = sim_us * (F_CPU / 1000000UL);
+
+	// TOV1 is cleared by writing 1 to it or by running the vector, which a plain variable can't mimic
+	TIFR1 = 0;
+	if (TCCR1B == 0)
+		return;
+
+	while ((timer_cycles >> 16) != (cycles >> 16))
+	{
+		timer_cycles = (timer_cycles | 0xFFFF) + 1;
+		TCNT1 = 0;
+		if (TIMSK1 & (1 << TOIE1))
+			TIMER1_OVF_vect();
+	}
+	timer_cycles = cycles;
+	TCNT1 = cycles & 0xFFFF;
+}
+
+// Timer0 in CTC mode, as used for the alerts
+static const uint16_t timer0_prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+static uint32_t next_compare0_us = 0;
+
+// Only built with ALERT=1
+__attribute__((weak)) void TIMER0_COMPA_vect(void)
+{
+}
+
+static void AdvanceTimer0(void)
+{
+	const uint16_t prescaler = timer0_prescalers[TCCR0B & 0x07];
+	if (prescaler == 0 || !(TCCR0A & (1 << WGM01)))
+	{
+		next_compare0_us = 0;
+		return;
+	}
+
+	const uint32_t period_us = (uint32_t)(OCR0A + 1) * prescaler / (F_CPU / 1000000UL);
+	if (next_compare0_us == 0)
+		next_compare0_us = sim_us + period_us;
+	// the vector may stop the timer
+	while (next_compare0_us != 0 && next_compare0_us <= sim_us)
+	{
+		next_compare0_us += period_us;
+		if (TIMSK0 & (1 << OCIE0A))
+			TIMER0_COMPA_vect();
+		if ((TCCR0B & 0x07) == 0)
+			next_compare0_us = 0;
+	}
+}
+
+// USB: one IN bank the host empties every sim_poll_us
+static uint8_t selected_endpoint = 0;
+static bool is_in_bank_full = false;
+static USB_JoystickReport_Input_t in_bank;
+static uint8_t in_bank_len = 0;
+static uint32_t next_poll_us = 0;
+static uint32_t next_sof_us = 1000;
+
+static void PollHost(void)
+{
+	while (next_poll_us <= sim_us)
+	{
+		next_poll_us += sim_poll_us;
+		if (USB_DeviceState != DEVICE_STATE_Configured)
+			continue;
+
+		sim_poll_count++;
+		if (!is_in_bank_full)
+		{
+			// the controller answers with NAK
+			sim_missed_polls++;
+			UEINTX |= (1 << NAKINI);
+			continue;
+		}
+
+		is_in_bank_full = false;
+		if (sim_on_report != NULL)
+			sim_on_report(&in_bank);
+	}
+}
+
+// OUT packets from the host, taken one per pass of the main loop
+#define SIM_OUT_PACKETS 64
+static uint8_t out_data[SIM_OUT_PACKETS][JOYSTICK_EPSIZE];
+static uint8_t out_len[SIM_OUT_PACKETS];
+static uint32_t out_at[SIM_OUT_PACKETS];
+static uint8_t out_count = 0;
+static uint8_t out_pos = 0;
+static uint8_t out_read = 0; // bytes of the packet at out_pos read so far
+
+void SimSendOut(const uint32_t at_us, const uint8_t* const data, const uint8_t len)
+{
+	if (out_count == SIM_OUT_PACKETS)
+		return;
+
+	const uint8_t size = len < JOYSTICK_EPSIZE ? len : JOYSTICK_EPSIZE;
+	memcpy(out_data[out_count], data, size);
+	out_len[out_count] = size;
+	out_at[out_count] = at_us;
+	out_count++;
+}
+
+static bool IsOUTPending(void)
+{
+	return out_pos < out_count && out_at[out_pos] <= sim_us;
+}
+
+bool Endpoint_ConfigureEndpoint(uint8_t Address, uint8_t Type, uint16_t Size, uint8_t Banks)
+{
+	return true;
+}
+
+void Endpoint_SelectEndpoint(uint8_t Address)
+{
+	selected_endpoint = Address;
+}
+
+bool Endpoint_IsINReady(void)
+{
+	return selected_endpoint != JOYSTICK_IN_EPADDR || !is_in_bank_full;
+}
+
+bool Endpoint_IsOUTReceived(void)
+{
+	return selected_endpoint == JOYSTICK_OUT_EPADDR && IsOUTPending();
+}
+
+bool Endpoint_IsReadWriteAllowed(void)
+{
+	return true;
+}
+
+uint16_t Endpoint_BytesInEndpoint(void)
+{
+	if (selected_endpoint != JOYSTICK_OUT_EPADDR || !IsOUTPending())
+		return 0;
+	return out_len[out_pos] - out_read;
+}
+
+void Endpoint_Write_8(uint8_t Data)
+{
+	if (selected_endpoint == JOYSTICK_IN_EPADDR && in_bank_len < sizeof(in_bank))
+		((uint8_t*)&in_bank)[in_bank_len++] = Data;
+}
+
+uint8_t Endpoint_Read_8(void)
+{
+	if (Endpoint_BytesInEndpoint() == 0)
+		return 0;
+	return out_data[out_pos][out_read++];
+}
+
+uint8_t Endpoint_Write_Control_Stream_LE(const void* Buffer, uint16_t Length)
+{
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t Endpoint_Read_Control_Stream_LE(void* Buffer, uint16_t Length)
+{
+	memset(Buffer, 0, Length);
+	return ENDPOINT_RWSTREAM_NoError;
+}
+
+void Endpoint_ClearIN(void)
+{
+	if (selected_endpoint == JOYSTICK_IN_EPADDR)
+	{
+		is_in_bank_full = true;
+		in_bank_len = 0;
+	}
+}
+
+void Endpoint_ClearOUT(void)
+{
+	if (selected_endpoint == JOYSTICK_OUT_EPADDR && IsOUTPending())
+	{
+		out_pos++;
+		out_read = 0;
+	}
+}
+
+void Endpoint_ClearSETUP(void)
+{
+}
+
+// The device is enumerated right away
+void USB_Init(void)
+{
+	USB_DeviceState = DEVICE_STATE_Configured;
+	EVENT_USB_Device_ConfigurationChanged();
+}
+
+void USB_Disable(void)
+{
+	USB_DeviceState = DEVICE_STATE_Unattached;
+}
+
+// Main loop
+static jmp_buf exit_point;
+static uint32_t run_until_us;
+
+void USB_USBTask(void)
+{
+	if (sim_us >= run_until_us)
+		longjmp(exit_point, 1);
+
+	sim_us += sim_loop_us;
+
+	AdvanceTimer();
+	AdvanceTimer0();
+	if (sim_on_ports != NULL && PORTB != last_portb)
+	{
+		last_portb = PORTB;
+		sim_on_ports(PORTB, PORTD);
+	}
+	while (next_sof_us <= sim_us)
+	{
+		next_sof_us += 1000;
+		EVENT_USB_Device_StartOfFrame();
+	}
+	DeliverSerial();
+	PollHost();
+}
+
+void SimRunFirmware(const uint32_t until_us)
+{
+	run_until_us = until_us;
+	if (setjmp(exit_point) == 0)
+		firmware_main();
+}
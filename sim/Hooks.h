@@ -0,0 +1,48 @@
+/** \file
+ *
+ *  Header file for Hooks.c.
+ */
+
+#ifndef _SIM_HOOKS_H_
+#define _SIM_HOOKS_H_
+
+#include "Joystick.h"
+
+// Simulated time in microseconds since reset
+extern uint32_t sim_us;
+// How often the host polls the IN endpoint (the Switch polls every 8 ms)
+extern uint32_t sim_poll_us;
+// Simulated time taken by one pass of the main loop
+extern uint32_t sim_loop_us;
+// Current rate of the serial line, as set by Serial_Init()
+extern uint32_t sim_baud;
+
+// Polls that found no report in the IN bank
+extern uint32_t sim_missed_polls;
+extern uint32_t sim_poll_count;
+
+// Called when the host takes a report from the IN endpoint
+extern void (*sim_on_report)(const USB_JoystickReport_Input_t* const report);
+// Called for every byte the MCU sends over the serial line (printf included)
+extern void (*sim_on_tx)(const uint8_t c);
+
+// Called when PORTB changes (the alert pins, see Alert.h)
+extern void (*sim_on_ports)(const uint8_t portb, const uint8_t portd);
+
+// The firmware's main(), renamed by -Dmain=firmware_main
+int firmware_main(void);
+
+// Send bytes from the host, starting no earlier than at_us.
+// Bytes arrive one after another at the current baud rate.
+void SimSend(const uint32_t at_us, const uint8_t* const data, const uint16_t len);
+// Send an OUT packet from the USB host (a report of up to JOYSTICK_EPSIZE bytes),
+// received no earlier than at_us.
+void SimSendOut(const uint32_t at_us, const uint8_t* const data, const uint8_t len);
+// return: every byte sent by SimSend() has arrived?
+bool SimIsSerialIdle(void);
+
+// Run firmware_main() from reset until sim_us reaches until_us.
+// The firmware keeps its state afterwards, but main() can't be resumed.
+void SimRunFirmware(const uint32_t until_us);
+
+#endif
@@ -0,0 +1,325 @@
+/*
+Serial trace player
+
+Runs the firmware on the host, feeds it a trace of what the PC sends and
+prints what the Switch would see: every change of the IN report and every
+line or reply the MCU sends back. "make sim-test" compares the output of each
+trace in sim/traces with its .expected file.
+
+usage: sim [-p poll_ms] [-l loop_us] trace
+
+Trace format, one event per line ('#' starts a comment):
+	<ms> line <text>           a text line, sent with "\r\n"
+	<ms> frame <type> <hex>..  a binary frame (LEN and SUM are filled in)
+	<ms> bytes <hex>..         raw bytes
+	<ms> out <hex>..           an OUT report from the USB host
+	<ms> end                   stop the simulation
+Events are sent in order, each no earlier than its time.
+
+A binary trace recorded by Sender (see SerialController/Commands/InputTrace.py)
+is played as the session that made it: "binary" first, then every report as a
+frame at the time it was recorded (FRAME_QUEUE for queued ones).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Hooks.h"
+#include "Protocol.h"
+
+static USB_JoystickReport_Input_t last_report;
+static bool is_first_report = true;
+static uint32_t report_changes = 0;
+
+static char tx_text[256];
+static uint16_t tx_len = 0;
+
+static void PrintTime(void)
+{
+	printf("%9.3f ", sim_us / 1000.0);
+}
+
+static void OnReport(const USB_JoystickReport_Input_t* const report)
+{
+	if (!is_first_report && memcmp(report, &last_report, sizeof(last_report)) == 0)
+		return;
+
+	is_first_report = false;
+	report_changes++;
+	memcpy(&last_report, report, sizeof(last_report));
+
+	PrintTime();
+	printf("report %04x %u %3u %3u %3u %3u\n", report->Button, report->HAT,
+		report->LX, report->LY, report->RX, report->RY);
+}
+
+static void OnPorts(const uint8_t portb, const uint8_t portd)
+{
+	PrintTime();
+	printf("ports %02x %02x\n", portb, portd);
+}
+
+static void FlushText(void)
+{
+	if (tx_len == 0)
+		return;
+
+	tx_text[tx_len] = '\0';
+	PrintTime();
+	printf("tx %s\n", tx_text);
+	tx_len = 0;
+}
+
+// Frame from the MCU being received: [SYNC] [LEN] [TYPE] [PAYLOAD] [SUM]
+static uint8_t rx_frame[FRAME_MAX_PAYLOAD + 4];
+static uint8_t rx_frame_len = 0; // 0 when not in a frame
+
+static void OnFrameByte(const uint8_t c)
+{
+	rx_frame[rx_frame_len++] = c;
+	if (rx_frame_len > 1 && rx_frame[1] > FRAME_MAX_PAYLOAD)
+	{
+		PrintTime();
+		printf("tx [bad frame length %u]\n", rx_frame[1]);
+		rx_frame_len = 0;
+		return;
+	}
+	if (rx_frame_len < 2 || rx_frame_len < rx_frame[1] + 4)
+		return;
+
+	uint8_t sum = 0;
+	for (uint8_t i = 1; i < rx_frame_len - 1; i++)
+		sum += rx_frame[i];
+
+	PrintTime();
+	printf("tx [FRAME %02x", rx_frame[2]);
+	for (uint8_t i = 3; i < rx_frame_len - 1; i++)
+		printf(" %02x", rx_frame[i]);
+	printf("]%s\n", sum == rx_frame[rx_frame_len - 1] ? "" : " bad sum");
+	rx_frame_len = 0;
+}
+
+static void OnTx(const uint8_t c)
+{
+	if (rx_frame_len > 0)
+		OnFrameByte(c);
+	else if (c == FRAME_SYNC)
+	{
+		FlushText();
+		OnFrameByte(c);
+	}
+	else if ((c & 0xC0) == PROTO_SEQ_ACK)
+	{
+		FlushText();
+		PrintTime();
+		printf("tx [%s %u]\n", (c & ~PROTO_SEQ_MASK) == PROTO_SEQ_NAK ? "NAK" : "ACK", c & PROTO_SEQ_MASK);
+	}
+	else if ((c & 0xF0) == PROTO_CREDIT)
+	{
+		FlushText();
+		PrintTime();
+		printf("tx [CREDIT %u]\n", c & PROTO_CREDIT_MASK);
+	}
+	else if (c == PROTO_ACK || c == PROTO_NAK)
+	{
+		FlushText();
+		PrintTime();
+		printf("tx [%s]\n", c == PROTO_ACK ? "ACK" : "NAK");
+	}
+	else if (c == '\n')
+		FlushText();
+	else if (c != '\r' && tx_len < sizeof(tx_text) - 1)
+		tx_text[tx_len++] = c;
+}
+
+static uint16_t ParseHex(char* text, uint8_t* const data, const uint16_t size)
+{
+	uint16_t len = 0;
+	for (char* tok = strtok(text, " \t"); tok != NULL && len < size; tok = strtok(NULL, " \t"))
+		data[len++] = (uint8_t)strtoul(tok, NULL, 16);
+	return len;
+}
+
+// return: the end of the trace in microseconds, or 0 on an error
+static uint32_t LoadTrace(FILE* const f)
+{
+	char line[512];
+	uint32_t end_us = 0;
+	int line_no = 0;
+
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		line_no++;
+		char* comment = strchr(line, '#');
+		if (comment != NULL)
+			*comment = '\0';
+		// trailing spaces before a comment aren't a part of the text
+		size_t end = strcspn(line, "\r\n");
+		while (end > 0 && (line[end - 1] == ' ' || line[end - 1] == '\t'))
+			end--;
+		line[end] = '\0';
+
+		double ms;
+		char kind[8];
+		int pos;
+		if (sscanf(line, " %lf %7s %n", &ms, kind, &pos) < 2)
+		{
+			if (strspn(line, " \t") == strlen(line))
+				continue;
+			fprintf(stderr, "line %d: bad event\n", line_no);
+			return 0;
+		}
+
+		const uint32_t at_us = (uint32_t)(ms * 1000);
+		char* args = line + pos;
+		uint8_t data[256];
+		uint16_t len;
+
+		if (strcmp(kind, "line") == 0)
+		{
+			len = snprintf((char*)data, sizeof(data), "%s\r\n", args);
+			SimSend(at_us, data, len);
+		}
+		else if (strcmp(kind, "frame") == 0)
+		{
+			// [SYNC] [LEN] [TYPE] [PAYLOAD] [SUM]
+			len = ParseHex(args, data + 2, FRAME_MAX_PAYLOAD + 1);
+			if (len == 0)
+			{
+				fprintf(stderr, "line %d: a frame needs a type\n", line_no);
+				return 0;
+			}
+			data[0] = FRAME_SYNC;
+			data[1] = len - 1;
+			uint8_t sum = 0;
+			for (uint16_t i = 1; i < len + 2; i++)
+				sum += data[i];
+			data[len + 2] = sum;
+			SimSend(at_us, data, len + 3);
+		}
+		else if (strcmp(kind, "bytes") == 0)
+		{
+			len = ParseHex(args, data, sizeof(data));
+			SimSend(at_us, data, len);
+		}
+		else if (strcmp(kind, "out") == 0)
+		{
+			len = ParseHex(args, data, JOYSTICK_EPSIZE);
+			SimSendOut(at_us, data, len);
+		}
+		else if (strcmp(kind, "end") == 0)
+		{
+			end_us = at_us;
+			break;
+		}
+		else
+		{
+			fprintf(stderr, "line %d: unknown event '%s'\n", line_no, kind);
+			return 0;
+		}
+	}
+
+	if (end_us == 0)
+		fprintf(stderr, "the trace has no end\n");
+	return end_us;
+}
+
+// See InputTrace.py
+#define INPUT_TRACE_HEADER_SIZE 12
+#define INPUT_TRACE_RECORD_SIZE 17
+// the recorded session starts after the handshake and ends a while after its last report
+#define INPUT_TRACE_START_US 20000
+#define INPUT_TRACE_TAIL_US  500000
+
+static bool IsInputTrace(FILE* const f)
+{
+	char magic[4];
+	const bool is_input_trace = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+		memcmp(magic, "PCIT", sizeof(magic)) == 0;
+	rewind(f);
+	return is_input_trace;
+}
+
+// return: the end of the trace in microseconds, or 0 on an error
+static uint32_t LoadInputTrace(FILE* const f)
+{
+	uint8_t header[INPUT_TRACE_HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), f) != sizeof(header) || header[4] != 1 ||
+		header[5] < INPUT_TRACE_RECORD_SIZE)
+	{
+		fprintf(stderr, "unsupported input trace\n");
+		return 0;
+	}
+	const uint8_t record_size = header[5];
+
+	static const char handshake[] = "binary\r\n";
+	SimSend(0, (const uint8_t*)handshake, sizeof(handshake) - 1);
+
+	uint8_t record[256];
+	uint32_t end_us = INPUT_TRACE_START_US;
+	while (fread(record, 1, record_size, f) == record_size)
+	{
+		uint64_t ns = 0;
+		for (int i = 7; i >= 0; i--)
+			ns = (ns << 8) | record[i];
+		const uint32_t at_us = INPUT_TRACE_START_US + (uint32_t)(ns / 1000);
+		const bool is_queued = record[15] != 0 || record[16] != 0;
+
+		// [SYNC] [LEN] [TYPE] [Button L] [Button H] [HAT] [LX] [LY] [RX] [RY] ([polls L] [polls H]) [SUM]
+		uint8_t frame[13];
+		const uint8_t len = is_queued ? 9 : 7;
+		frame[0] = FRAME_SYNC;
+		frame[1] = len;
+		frame[2] = is_queued ? FRAME_QUEUE : FRAME_REPORT;
+		memcpy(&frame[3], &record[8], 9);
+		uint8_t sum = 0;
+		for (uint8_t i = 1; i < len + 3; i++)
+			sum += frame[i];
+		frame[len + 3] = sum;
+
+		SimSend(at_us, frame, len + 4);
+		end_us = at_us;
+	}
+	return end_us + INPUT_TRACE_TAIL_US;
+}
+
+int main(int argc, char* argv[])
+{
+	int i;
+	for (i = 1; i < argc - 1; i += 2)
+	{
+		if (strcmp(argv[i], "-p") == 0)
+			sim_poll_us = (uint32_t)(atof(argv[i + 1]) * 1000);
+		else if (strcmp(argv[i], "-l") == 0)
+			sim_loop_us = (uint32_t)atoi(argv[i + 1]);
+		else
+			break;
+	}
+	if (i != argc - 1 || sim_poll_us == 0 || sim_loop_us == 0)
+	{
+		fprintf(stderr, "usage: %s [-p poll_ms] [-l loop_us] trace\n", argv[0]);
+		return 2;
+	}
+
+	FILE* f = fopen(argv[i], "rb");
+	if (f == NULL)
+	{
+		perror(argv[i]);
+		return 2;
+	}
+	const uint32_t end_us = IsInputTrace(f) ? LoadInputTrace(f) : LoadTrace(f);
+	fclose(f);
+	if (end_us == 0)
+		return 2;
+
+	sim_on_report = OnReport;
+	sim_on_tx = OnTx;
+	sim_on_ports = OnPorts;
+	SimRunFirmware(end_us);
+	FlushText();
+
+	PrintTime();
+	printf("end polls %u missed %u changes %u%s\n", sim_poll_count, sim_missed_polls,
+		report_changes, SimIsSerialIdle() ? "" : " (input left unsent)");
+	return 0;
+}
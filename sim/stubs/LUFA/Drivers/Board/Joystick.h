@@ -0,0 +1,2 @@
+// Host stand-in for the LUFA board driver (unused).
+#pragma once
@@ -0,0 +1,13 @@
+// Host stand-in for the LUFA USART driver. Transmitted bytes go to a simulator hook.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+void Serial_Init(uint32_t BaudRate, bool DoubleSpeed);
+void Serial_CreateStream(FILE* Stream);
+void Serial_SendByte(char DataByte);
+bool Serial_IsSendReady(void);
+bool Serial_IsSendComplete(void);
+int16_t Serial_ReceiveByte(void);
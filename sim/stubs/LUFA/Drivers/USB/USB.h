@@ -0,0 +1,75 @@
+// Host stand-in for the parts of the LUFA USB stack the firmware uses.
+// Endpoint traffic is routed to hooks implemented by the simulator driver.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define ATTR_WARN_UNUSED_RESULT
+#define ATTR_NON_NULL_PTR_ARG(...)
+
+// Device state
+enum USB_Device_States_t {
+	DEVICE_STATE_Unattached = 0,
+	DEVICE_STATE_Powered,
+	DEVICE_STATE_Default,
+	DEVICE_STATE_Addressed,
+	DEVICE_STATE_Configured,
+	DEVICE_STATE_Suspended,
+};
+extern volatile uint8_t USB_DeviceState;
+
+// Control requests
+typedef struct {
+	uint8_t  bmRequestType;
+	uint8_t  bRequest;
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+} USB_Request_Header_t;
+extern USB_Request_Header_t USB_ControlRequest;
+
+#define REQDIR_HOSTTODEVICE (0 << 7)
+#define REQDIR_DEVICETOHOST (1 << 7)
+#define REQTYPE_CLASS       (1 << 5)
+#define REQREC_INTERFACE    (1 << 0)
+#define HID_REQ_GetReport   0x01
+#define HID_REQ_SetReport   0x09
+
+// Endpoints
+#define ENDPOINT_DIR_OUT 0x00
+#define ENDPOINT_DIR_IN  0x80
+#define EP_TYPE_INTERRUPT 0x03
+#define ENDPOINT_ATTR_NO_SYNC (0 << 2)
+#define ENDPOINT_USAGE_DATA   (0 << 4)
+#define ENDPOINT_RWSTREAM_NoError 0
+
+bool     Endpoint_ConfigureEndpoint(uint8_t Address, uint8_t Type, uint16_t Size, uint8_t Banks);
+void     Endpoint_SelectEndpoint(uint8_t Address);
+bool     Endpoint_IsINReady(void);
+bool     Endpoint_IsOUTReceived(void);
+bool     Endpoint_IsReadWriteAllowed(void);
+uint16_t Endpoint_BytesInEndpoint(void);
+void     Endpoint_Write_8(uint8_t Data);
+uint8_t  Endpoint_Read_8(void);
+uint8_t  Endpoint_Write_Control_Stream_LE(const void* Buffer, uint16_t Length);
+uint8_t  Endpoint_Read_Control_Stream_LE(void* Buffer, uint16_t Length);
+void     Endpoint_ClearIN(void);
+void     Endpoint_ClearOUT(void);
+void     Endpoint_ClearSETUP(void);
+
+void USB_Init(void);
+void USB_Disable(void);
+void USB_USBTask(void);
+#define USB_Device_EnableSOFEvents()
+#define USB_Device_DisableSOFEvents()
+#define GlobalInterruptEnable()
+#define GlobalInterruptDisable()
+
+// Descriptor types used by Descriptors.h
+typedef struct { uint8_t Size; uint8_t Type; } USB_Descriptor_Header_t;
+typedef struct { USB_Descriptor_Header_t Header; uint16_t TotalConfigurationSize; uint8_t TotalInterfaces; uint8_t ConfigurationNumber; uint8_t ConfigurationStrIndex; uint8_t ConfigAttributes; uint8_t MaxPowerConsumption; } USB_Descriptor_Configuration_Header_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t InterfaceNumber; uint8_t AlternateSetting; uint8_t TotalEndpoints; uint8_t Class; uint8_t SubClass; uint8_t Protocol; uint8_t InterfaceStrIndex; } USB_Descriptor_Interface_t;
+typedef struct { USB_Descriptor_Header_t Header; uint16_t HIDSpec; uint8_t CountryCode; uint8_t TotalReportDescriptors; uint8_t HIDReportType; uint16_t HIDReportLength; } USB_HID_Descriptor_HID_t;
+typedef struct { USB_Descriptor_Header_t Header; uint8_t EndpointAddress; uint8_t Attributes; uint16_t EndpointSize; uint8_t PollingIntervalMS; } USB_Descriptor_Endpoint_t;
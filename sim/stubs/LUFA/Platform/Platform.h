@@ -0,0 +1,2 @@
+// Host stand-in for the LUFA platform header (unused).
+#pragma once
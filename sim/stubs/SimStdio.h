@@ -0,0 +1,8 @@
+// Included before every firmware source (-include) so that printf goes to the simulated
+// serial port, like the stream made by Serial_CreateStream() on the MCU.
+#pragma once
+
+#include <stdio.h>
+
+int SimPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+#define printf SimPrintf
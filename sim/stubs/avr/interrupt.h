@@ -0,0 +1,10 @@
+// Host stand-in for <avr/interrupt.h>: vectors become ordinary functions the simulator calls.
+#pragma once
+
+#define ISR(vector, ...) void vector(void)
+#define sei()
+#define cli()
+
+void USART1_RX_vect(void);
+void TIMER1_OVF_vect(void);
+void TIMER0_COMPA_vect(void);
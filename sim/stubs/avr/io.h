@@ -0,0 +1,49 @@
+// Host stand-in for <avr/io.h>: the registers the firmware touches are plain globals.
+#pragma once
+
+#include <stdint.h>
+
+extern volatile uint8_t  UDR1, UCSR1A, UCSR1B, UCSR1C;
+extern volatile uint16_t UBRR1;
+extern volatile uint8_t  DDRB, PORTB, DDRD, PORTD;
+extern volatile uint8_t  MCUSR;
+extern volatile uint8_t  TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1;
+extern volatile uint8_t  TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+extern volatile uint8_t  UEINTX;
+
+// UCSR1A
+#define MPCM1  0
+#define U2X1   1
+#define UPE1   2
+#define DOR1   3
+#define FE1    4
+#define UDRE1  5
+#define TXC1   6
+#define RXC1   7
+// UCSR1B
+#define TXB81  0
+#define RXB81  1
+#define UCSZ12 2
+#define TXEN1  3
+#define RXEN1  4
+#define UDRIE1 5
+#define TXCIE1 6
+#define RXCIE1 7
+// MCUSR
+#define WDRF   3
+// Timer1
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define TOIE1  0
+#define TOV1   0
+// Timer0
+#define WGM01  1
+#define CS00   0
+#define CS01   1
+#define CS02   2
+#define OCIE0A 1
+#define OCF0A  1
+// UEINTX
+#define NAKINI 6
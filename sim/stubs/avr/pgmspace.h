@@ -0,0 +1,14 @@
+// Host stand-in for <avr/pgmspace.h>: flash and RAM share one address space.
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define printf_P printf
+#define pgm_read_byte(addr)  (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t*)(addr))
+#define pgm_read_ptr(addr)   (*(void* const*)(addr))
@@ -0,0 +1,5 @@
+// Host stand-in for <avr/power.h>.
+#pragma once
+
+#define clock_div_1 0
+#define clock_prescale_set(x)
@@ -0,0 +1,6 @@
+// Host stand-in for <util/atomic.h>: the simulator never interrupts the main loop.
+#pragma once
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int _atomic_once = 1; _atomic_once; _atomic_once = 0)